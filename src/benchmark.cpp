@@ -72,19 +72,33 @@ void benchmark_nn(){
     std::cout << "evaluation function benchmark: \n";
 
     NnueBoard board = NnueBoard();
+    NNUE::InferenceContext ctx;
 
-    auto start = high_resolution_clock::now();
-    for (int i = 0; i < 10'000'000; i++)
-        board.evaluate();
+    // the network is run directly, as board.evaluate() would only hit the eval cache.
+    // every kernel supported by this cpu, the one used by the engine comes first.
+    auto kernels = NNUE::supported_kernels();
+    for (auto table: kernels){
+        NNUE::set_kernels(*table);
+
+        auto start = high_resolution_clock::now();
+        for (int i = 0; i < 10'000'000; i++)
+            NNUE::run(board.accumulators_stack.top(), board.sideToMove(), board.occ().count(), ctx);
+
+        int mean = 1000*duration_cast<microseconds>(high_resolution_clock::now() - start).count()/10'000'000;
+        std::cout << table->name << " time taken: " << mean << " nanoseconds per call\n";
+    }
+    NNUE::set_kernels(*kernels.front());
 
-    int mean = 1000*duration_cast<microseconds>(high_resolution_clock::now() - start).count()/10'000'000;
-    std::cout << "time taken: " << mean << " nanoseconds per call\n";
     std::cout << "============================== \n";
 }
 
 void benchmark_engine(Engine& engine, int depth){
 
     engine.clear_state();
+    engine.pos.num_refreshes = 0;
+    engine.pos.num_refreshed_features = 0;
+    engine.pos.eval_cache_hits = 0;
+    engine.pos.eval_cache_misses = 0;
 
     std::vector<int> times;
     std::vector<int> nodes;
@@ -97,10 +111,11 @@ void benchmark_engine(Engine& engine, int depth){
         start_time = high_resolution_clock::now();
 
         engine.pos.setFen(fen);
+        engine.tt.new_search();
         engine.iterative_deepening(SearchLimit(LimitType::Depth, depth));
 
         times.push_back(duration_cast<milliseconds>(high_resolution_clock::now() - start_time).count());
-        nodes.push_back(engine.nodes);
+        nodes.push_back(engine.nodes.get());
 
         std::cout << std::endl;
     }
@@ -111,6 +126,13 @@ void benchmark_engine(Engine& engine, int depth){
     std::cout << "average nodes: " << sum(nodes) / fens.size() << std::endl;
     std::cout << "total time: " << sum(times) << " ms" << std::endl;
     std::cout << "average nodes per second: " << 1000 * sum(nodes) / sum(times) << std::endl;
+    std::cout << "accumulator refreshes: " << engine.pos.num_refreshes << std::endl;
+    if (engine.pos.num_refreshes > 0)
+        std::cout << "average features per refresh: "
+                  << static_cast<double>(engine.pos.num_refreshed_features) / engine.pos.num_refreshes << std::endl;
+    if (engine.pos.eval_cache_enabled())
+        std::cout << "eval cache hits: " << engine.pos.eval_cache_hits
+                  << " misses: " << engine.pos.eval_cache_misses << std::endl;
     std::cout << "=================================" << std::endl;
 
     engine.pos.setFen(constants::STARTPOS);
@@ -134,7 +156,7 @@ void benchmark_ft_activation(){
         Accumulators& accumulators = board.accumulators_stack.top();
         uint8_t pairwise_output[ACC_SIZE / 2];
 
-        NNUE_UTILS::pairwise_screlu16_to_8(
+        NNUE::pairwise_screlu16_to_8(
             &accumulators[stm][0],
             &accumulators[stm][ACC_SIZE / 2],
             pairwise_output, ACC_SIZE / 2
@@ -1,5 +1,4 @@
 #include "core.hpp"
-#include "nnue_misc.hpp"
 #include <fstream>
 
 namespace Benchmark {
@@ -85,6 +85,8 @@ constexpr int GENFENS_MAX_VALUE = 600;
 
 constexpr int TT_MIN_SIZE = 2;
 constexpr int TT_MAX_SIZE = 4096;
+constexpr int TT_CLUSTER_SIZE = 6;
+constexpr int TT_NUM_GENERATIONS = 32;
 
 constexpr int MAX_PLY = 256;
 constexpr int STACK_PADDING_SIZE = 2;
@@ -94,6 +96,12 @@ constexpr int LONG_BENCHMARK_DEPTH = 18;
 
 constexpr int ENGINE_MAX_DEPTH = 255;
 
+// lazy smp: helper thread i skips the iterations where (depth + SKIP_PHASE[j]) / SKIP_SIZE[j]
+// is odd, with j = (i - 1) % NUM_SKIP_PATTERNS, so threads search different depths at the same time.
+constexpr int NUM_SKIP_PATTERNS = 20;
+constexpr int SKIP_SIZE[NUM_SKIP_PATTERNS] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+constexpr int SKIP_PHASE[NUM_SKIP_PATTERNS] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
 constexpr int DEPTH_UNSEARCHED = -1;
 constexpr int DEPTH_QSEARCH = 0;
 
@@ -72,10 +72,16 @@ int get_think_time(float time_left, int num_moves_out_of_book, int num_moves_unt
     return static_cast<int>(target + 0.9F*increment);
 }
 
-Engine::Engine(bool display_uci, TranspositionTable& tt, std::atomic<int64_t>& nodes)
+Engine::Engine(bool display_uci, TranspositionTable& tt, NodeCounters& search_nodes)
     : display_uci(display_uci),
-      tt(tt),
-      nodes(nodes) {};
+      search_nodes(search_nodes),
+      tt(tt) {
+    search_nodes.add(&nodes);
+};
+
+Engine::~Engine(){
+    search_nodes.remove(&nodes);
+}
 
       
 int Engine::get_corrhist(Color color){
@@ -87,18 +93,29 @@ int Engine::get_corrhist(Color color){
         ) / 32768;
 }
 
+SearchLimit Engine::adjust_limit(SearchLimit limit){
+    if (nonsense_stage >= Nonsense::PROMOTE && limit.type == LimitType::Time)
+        return SearchLimit(LimitType::Time, std::min(limit.value, 200)); // move quickly
+    return limit;
+}
+
+// time limits are not checked here, the SearchTimer of the WorkerPool sets the
+// interrupt flag when they are reached.
 bool Engine::update_interrupt_flag(){
+    // the flag is only ever set here, never reset, so that a concurrent stop command is not lost.
     SearchLimit limit_ = limit.load();
     switch (limit_.type){
-        case LimitType::Time:
-            update_run_time();
-            interrupt_flag = (run_time >= limit_.value);
-            break;
-        case LimitType::Nodes:
-            interrupt_flag = (nodes >= limit_.value);
+        case LimitType::Nodes: {
+            int64_t total_nodes = search_nodes.total();
+            if (total_nodes >= limit_.value)
+                interrupt_flag = true;
+            // check again before the limit can be exceeded, so single threaded searches stop exactly on it.
+            next_limit_check = nodes.get() + std::clamp<int64_t>(limit_.value - total_nodes, 1, 2048);
             break;
+        }
         default:
-            interrupt_flag = false;
+            // the limit only changes to a time limit on ponderhit.
+            next_limit_check = std::numeric_limits<int64_t>::max();
             break;
     }
     return interrupt_flag;
@@ -106,6 +123,10 @@ bool Engine::update_interrupt_flag(){
 
 void Engine::clear_state(){
     tt.clear();
+    clear_histories();
+}
+
+void Engine::clear_histories(){
     capt_history.clear();
     history.clear();
     pawn_corrhist.clear();
@@ -118,6 +139,10 @@ void Engine::clear_state(){
     killer_moves.clear();
 }
 
+// written at the start of saved states, bumped whenever the layout of a saved table changes.
+// version 2 stores histories as int16_t.
+constexpr uint32_t STATE_VERSION = 2;
+
 void Engine::save_state(std::string file){
     std::ofstream ofs(file, std::ios::binary | std::ios::out);
     if (!ofs) {
@@ -125,6 +150,7 @@ void Engine::save_state(std::string file){
         return;
     }
 
+    ofs.write(reinterpret_cast<const char*>(&STATE_VERSION), sizeof(STATE_VERSION));
     tt.save_to_stream(ofs);
     capt_history.save_to_stream(ofs);
     history.save_to_stream(ofs);
@@ -147,6 +173,13 @@ void Engine::load_state(std::string file){
         return;
     }
 
+    uint32_t version = 0;
+    ifs.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (version != STATE_VERSION) {
+        std::cout << "Unsupported state file version." << std::endl;
+        return;
+    }
+
     tt.load_from_stream(ifs);
     capt_history.load_from_stream(ifs);
     history.load_from_stream(ifs);
@@ -168,26 +201,62 @@ void Engine::update_run_time(){
     ).count() + 1; // add 1 to avoid divisions by 0
 };
 
-std::pair<std::string, std::string> Engine::get_pv_pmove(){
-    std::string pv = "";
-    std::string ponder_move = "";
+// the root line is only collected when a root move raised alpha
+void Engine::save_root_pv(Move root_move){
+    if (pv_table[0].length == 0 || pv_table[0].moves[0] != root_move)
+        return;
 
-    Board pv_visitor = pos;
+    for (PVLine& line: root_pvs){
+        if (line.moves[0] == root_move){
+            line = pv_table[0];
+            return;
+        }
+    }
+    root_pvs.push_back(pv_table[0]);
+}
 
-    for (int i = 0; i < root_depth; i++){
-        bool is_hit;
-        TTData transposition = tt.probe(is_hit, pv_visitor.hash(), false);
-        if (transposition.move == Move::NO_MOVE || pv_visitor.isRepetition(2)
-            || pv_visitor.isHalfMoveDraw() || pv_visitor.isInsufficientMaterial())
-            break;
+const PVLine* Engine::find_root_pv(Move root_move){
+    for (const PVLine& line: root_pvs)
+        if (line.moves[0] == root_move)
+            return &line;
+    return nullptr;
+}
 
-        if (i == 1)
-            ponder_move = uci::moveToUci(transposition.move);
+std::string Engine::pv_string(Move root_move){
+    const PVLine* line = find_root_pv(root_move);
+    if (line == nullptr)
+        return " " + uci::moveToUci(root_move);
 
-        pv += " " + uci::moveToUci(transposition.move);
-        pv_visitor.makeMove(transposition.move);
-    }
-    return std::pair(pv, ponder_move);
+    std::string pv = "";
+    for (int i = 0; i < line->length; i++)
+        pv += " " + uci::moveToUci(line->moves[i]);
+    return pv;
+}
+
+std::string Engine::ponder_move_string(Move root_move){
+    const PVLine* line = find_root_pv(root_move);
+    if (line == nullptr || line->length < 2)
+        return "";
+    return uci::moveToUci(line->moves[1]);
+}
+
+void Engine::print_info(int line, Move root_move, int depth, int num_lines, const std::string& pv){
+    std::cout << "info depth " << depth;
+    std::cout << " seldepth " << seldepth;
+    if (num_lines > 1)
+        std::cout << " multipv " << line + 1;
+    if (is_mate(root_move.score()))
+        std::cout << " score mate " << get_mate_in_moves(root_move.score()); 
+    else
+        std::cout << " score cp " << root_move.score();
+
+    int64_t total_nodes = search_nodes.total();
+    std::cout << " nodes " << total_nodes;
+    std::cout << " nps " << total_nodes * 1000 / run_time;
+    std::cout << " tbhits " << tb_hits;
+    std::cout << " time " << run_time;
+    std::cout << " hashfull " << tt.hashfull();
+    std::cout << " pv" << pv << std::endl;
 }
 
 Move Engine::iterative_deepening(SearchLimit limit){
@@ -202,14 +271,10 @@ Move Engine::iterative_deepening(SearchLimit limit){
         }
     }
 
-    if (nonsense_stage >= Nonsense::PROMOTE && limit.type == LimitType::Time)
-        this->limit = SearchLimit(LimitType::Time, std::min(limit.value, 200)); // move quickly
-    else
-        this->limit = limit;
+    this->limit = adjust_limit(limit);
 
     start_time = std::chrono::high_resolution_clock::now();
 
-    std::string pv;
     std::string ponder_move = "";
 
     Move best_move = Move::NO_MOVE;
@@ -217,12 +282,17 @@ Move Engine::iterative_deepening(SearchLimit limit){
 
     killer_moves.clear();
 
-    nodes = 0;
+    nodes.reset();
+    next_limit_check = 0;
     tb_hits = 0;
     seldepth = 0;
     root_depth = 0;
 
     root_moves.clear();
+    root_pvs.clear();
+    pv_idx = 0;
+    completed_depth = 0;
+    completed_move = Move::NO_MOVE;
 
     // initialize stack
     for (int i = 0; i < MAX_PLY + STACK_PADDING_SIZE; i++)
@@ -275,9 +345,18 @@ Move Engine::iterative_deepening(SearchLimit limit){
             break;
     }
     int best_move_changes = 0;
+    // multipv line scores of the previous depth, the first search of a depth overwrites them
+    std::vector<int> previous_scores;
     while (true){
         root_depth++;
 
+        if (skip_depth(root_depth))
+            continue;
+
+        previous_scores.clear();
+        for (int line = 0; line < std::min(multi_pv, root_moves.size()); line++)
+            previous_scores.push_back(root_moves[line].score());
+
         int asp_alpha;
         int asp_beta;
         if (root_depth <= 6){
@@ -298,6 +377,8 @@ Move Engine::iterative_deepening(SearchLimit limit){
             if (is_valid(root_moves[0].score()))
                 best_move = root_moves[0];
 
+            save_root_pv(best_move);
+
             assert(is_valid(best_move.score()));
 
             if (interrupt_flag)
@@ -314,40 +395,102 @@ Move Engine::iterative_deepening(SearchLimit limit){
             asp_beta = std::clamp(asp_beta, -INFINITE_VALUE, INFINITE_VALUE);
         }
 
+        // multipv: each other line searches the root moves not taken by the previous lines,
+        // with an aspiration window around the score of the same line at the previous depth.
+        const int num_lines = std::min(multi_pv, root_moves.size());
+        for (pv_idx = 1; pv_idx < num_lines && !interrupt_flag; pv_idx++){
+            if (root_depth <= 6 || pv_idx >= previous_scores.size() || !is_valid(previous_scores[pv_idx])){
+                asp_alpha = -INFINITE_VALUE;
+                asp_beta = INFINITE_VALUE;
+            } else {
+                int margin = asp_1 + asp_2 * std::abs(previous_scores[pv_idx]) / 1024;
+                asp_alpha = std::clamp(previous_scores[pv_idx] - margin, -INFINITE_VALUE, INFINITE_VALUE);
+                asp_beta = std::clamp(previous_scores[pv_idx] + margin, -INFINITE_VALUE, INFINITE_VALUE);
+            }
+
+            while (true){
+                negamax<true>(root_depth, asp_alpha, asp_beta, root_ss, false);
+                save_root_pv(root_moves[pv_idx]);
+
+                if (interrupt_flag)
+                    break;
+
+                if (root_moves[pv_idx].score() <= asp_alpha)
+                    asp_alpha -= asp_beta - asp_alpha;
+                else if (root_moves[pv_idx].score() >= asp_beta)
+                    asp_beta += asp_beta - asp_alpha;
+                else
+                    break;
+
+                asp_alpha = std::clamp(asp_alpha, -INFINITE_VALUE, INFINITE_VALUE);
+                asp_beta = std::clamp(asp_beta, -INFINITE_VALUE, INFINITE_VALUE);
+            }
+        }
+        // the line interrupted, if any, and the ones after it were not searched to this depth
+        const int finished_lines = pv_idx - interrupt_flag;
+        pv_idx = 0;
+
+        // search instability can leave a later line above the first one
+        if (finished_lines > 1){
+            std::stable_sort(root_moves.begin(), root_moves.begin() + finished_lines,
+                [](const Move& a, const Move& b){ return a.score() > b.score(); });
+            best_move = root_moves[0];
+        }
+
+        if (!interrupt_flag){
+            completed_depth = root_depth;
+            completed_move = best_move;
+        }
+
         if (display_uci){
-            std::pair<std::string, std::string> pv_pmove = get_pv_pmove();
-            pv = pv_pmove.first;
-            if (pv_pmove.second.size() > 0)
-                ponder_move = pv_pmove.second;
+            if (ponder_move_string(best_move).size() > 0)
+                ponder_move = ponder_move_string(best_move);
     
             update_run_time();
-    
+
             // do not count interrupted searches in depth
-            std::cout << "info depth " << root_depth - interrupt_flag;
-            std::cout << " seldepth " << seldepth;
-            if (is_mate(best_move.score()))
-                std::cout << " score mate " << get_mate_in_moves(best_move.score()); 
-            else
-                std::cout << " score cp " << best_move.score();
-    
-            std::cout << " nodes " << nodes;
-            std::cout << " nps " << nodes * 1000 / run_time;
-            std::cout << " tbhits " << tb_hits;
-            std::cout << " time " << run_time;
-            std::cout << " hashfull " << tt.hashfull();
-            std::cout << " pv" << pv << std::endl;
+            print_info(0, best_move, root_depth - (finished_lines == 0), num_lines, pv_string(best_move));
+            for (int line = 1; line < finished_lines; line++)
+                print_info(line, root_moves[line], root_depth, num_lines, pv_string(root_moves[line]));
         }
 
         // should the search really stop if there is a mate for the oponent?
         if (interrupt_flag
             || is_mate(best_move.score())
             || root_depth >= ENGINE_MAX_DEPTH
-            || (limit.type == LimitType::Depth && root_depth == limit.value)
-            || (limit.type == LimitType::Nodes && nodes >= limit.value)
+            || (limit.type == LimitType::Depth && root_depth >= limit.value)
+            || (limit.type == LimitType::Nodes && search_nodes.total() >= limit.value)
             || (limit.type == LimitType::Time && best_move_changes < 1 && run_time > 2*limit.value / 3))
             break;
     }
 
+    if (!helpers.empty()){
+        Move voted_move = vote_best_move(best_move);
+        if (voted_move != best_move){
+            best_move = voted_move;
+
+            // the helper that completed the deepest search of the voted move
+            Engine* source = nullptr;
+            for (Engine* helper: helpers)
+                if (helper->completed_depth > 0 && helper->completed_move == best_move
+                    && (source == nullptr || helper->completed_depth > source->completed_depth))
+                    source = helper;
+            assert(source != nullptr);
+
+            ponder_move = source->ponder_move_string(best_move);
+            for (Engine* helper: helpers)
+                if (ponder_move.empty())
+                    ponder_move = helper->ponder_move_string(best_move);
+
+            // so that the last reported line agrees with bestmove
+            if (display_uci){
+                update_run_time();
+                print_info(0, best_move, source->completed_depth, std::min(multi_pv, root_moves.size()),
+                    source->pv_string(best_move));
+            }
+        }
+    }
+
     if (is_nonsense){
         Nonsense::display_info();
         if (nonsense_stage == Nonsense::STANDARD){
@@ -374,6 +517,60 @@ Move Engine::iterative_deepening(SearchLimit limit){
     return best_move;
 }
 
+bool Engine::skip_depth(int depth){
+    if (thread_id == 0 || depth >= ENGINE_MAX_DEPTH)
+        return false;
+
+    // never skip the last iteration of a depth limited search
+    SearchLimit limit_ = limit.load();
+    if (limit_.type == LimitType::Depth && depth >= limit_.value)
+        return false;
+
+    int pattern = (thread_id - 1) % NUM_SKIP_PATTERNS;
+    return ((depth + SKIP_PHASE[pattern]) / SKIP_SIZE[pattern]) % 2 == 1;
+}
+
+// stops the helper threads, then lets every thread vote for its best move.
+// a vote is weighted by the depth the thread completed and by how its score
+// compares to the worst score among threads.
+Move Engine::vote_best_move(Move best_move){
+    for (Engine* helper: helpers)
+        helper->interrupt_flag = true;
+
+    for (Engine* helper: helpers)
+        while (helper->searching)
+            std::this_thread::yield();
+
+    std::vector<std::pair<Move, int>> results = {{best_move, completed_depth}};
+    for (Engine* helper: helpers)
+        if (helper->completed_depth > 0)
+            results.emplace_back(helper->completed_move, helper->completed_depth);
+
+    int min_score = INFINITE_VALUE;
+    for (auto& [move, depth]: results)
+        min_score = std::min(min_score, static_cast<int>(move.score()));
+
+    auto votes = [&](Move move){
+        int64_t sum = 0;
+        for (auto& [other, depth]: results)
+            if (other == move)
+                sum += static_cast<int64_t>(other.score() - min_score + 14) * depth;
+        return sum;
+    };
+
+    Move voted_move = best_move;
+    for (auto& [move, depth]: results){
+        // a shorter proven mate always wins, and no vote overrides a proven mate
+        if (is_win(voted_move.score())){
+            if (move.score() > voted_move.score())
+                voted_move = move;
+        } else if (is_win(move.score()) || votes(move) > votes(voted_move)){
+            voted_move = move;
+        }
+    }
+    return voted_move;
+}
+
 template<bool pv>
 int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
     assert(alpha < INFINITE_VALUE && beta > -INFINITE_VALUE);
@@ -387,9 +584,12 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
     const int ply = ss - root_ss;
     assert(ply < MAX_PLY); // avoid stack overflow
 
-    if (interrupt_flag || ((nodes & 2047) == 0 && update_interrupt_flag()))
+    if (pv)
+        pv_table[ply].clear();
+
+    if (interrupt_flag || (nodes.get() >= next_limit_check && update_interrupt_flag()))
         return NO_VALUE;
-    nodes.fetch_add(1, std::memory_order_relaxed);
+    nodes.increment();
 
     if (ply > seldepth)
         seldepth = ply;
@@ -397,12 +597,17 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
     if (root_node)
         pos.synchronize();
 
-    // a stalemate will be processed after the move generation
-    else if (pos.isRepetition(1))
+    // a stalemate will be processed after the move generation.
+    // a single repetition is a draw in the tree, but the root needs two.
+    if (pos.isRepetition(root_node ? 2 : 1) || pos.isHalfMoveDraw() || pos.isInsufficientMaterial())
         return 0;
 
-    if (pos.isRepetition(2) || pos.isHalfMoveDraw() || pos.isInsufficientMaterial())
-        return 0;
+    // the side to move can force a draw by repeating a position
+    if (!root_node && alpha < 0 && pos.upcoming_repetition(ply)){
+        alpha = 0;
+        if (alpha >= beta)
+            return alpha;
+    }
 
     if (ply >= MAX_PLY - 1)
         return evaluate(pos);
@@ -438,17 +643,18 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
     Piece prev_piece = (ss - 1)->moved_piece;
     Square prev_to = ((ss - 1)->curr_move == Move::NULL_MOVE || (ss - 1)->curr_move == Move::NO_MOVE)
                      ? Square::NO_SQ : (ss - 1)->curr_move.to();
-    Piece prev_piece2 = (ss - 2)->moved_piece;
-    Square prev_to2 = ((ss - 2)->curr_move == Move::NULL_MOVE || (ss - 2)->curr_move == Move::NO_MOVE)
-                      ? Square::NO_SQ : (ss - 2)->curr_move.to();
+    int16_t* cont_hist_row = (ss - 1)->cont_hist_row;
+    int16_t* cont_hist2_row = (ss - 2)->cont_hist2_row;
 
     const int initial_alpha = alpha;
     uint64_t zobrist_hash = pos.hash();
 
     SortedMoveGen move_gen = SortedMoveGen<GenType::NORMAL>(
-        root_node ? &root_moves : NULL, prev_piece, prev_to, prev_piece2, prev_to2, pos, depth,
+        root_node ? &root_moves : NULL, cont_hist_row, cont_hist2_row, pos, depth,
         killer_moves, history, cont_history, cont_history2, capt_history
     );
+    if (root_node)
+        move_gen.set_to_search_start(pv_idx);
 
     if (root_node && root_moves.empty()){
         movegen::legalmoves(root_moves, pos);
@@ -556,9 +762,11 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
             ss->moved_piece = Piece::NONE;
             ss->curr_move = Move::NULL_MOVE;
             ss->curr_move_capture = false;
+            ss->cont_hist_row = nullptr;
+            ss->cont_hist2_row = nullptr;
 
             pos.makeNullMove();
-            __builtin_prefetch(&tt.entries[pos.hash() & (tt.size - 1)]);
+            tt.prefetch(pos.hash());
 
             int null_move_value = -negamax<false>(depth - R, -beta, -beta + 1, ss + 1, false);
             pos.unmakeNullMove();
@@ -617,9 +825,8 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
                     continue;
 
                 // continuation history pruning
-                if (prev_piece != int(Piece::NONE)
-                    && prev_to != int(Square::underlying::NO_SQ)
-                    && cont_history.get(prev_piece, prev_to, pos.at(move.from()), move.to()) < -cthis_1 - cthis_2*depth)
+                if (cont_hist_row != nullptr
+                    && ContinuationHistory::get(cont_hist_row, from_piece, move.to()) < -cthis_1 - cthis_2*depth)
                     continue;
                 
                 // SEE pruning
@@ -661,6 +868,8 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
         ss->curr_move = move;
         ss->curr_move_capture = is_capture;
         pos.update_state(move, tt);
+        ss->cont_hist_row = cont_history.row(ss->moved_piece, move.to());
+        ss->cont_hist2_row = cont_history2.row(ss->moved_piece, move.to());
 
         bool gives_check = pos.inCheck();
 
@@ -691,13 +900,13 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
 
                 value = -negamax<false>(new_depth, -alpha - 1, -alpha, ss + 1, !cutnode);
                 if (!is_capture){
-                    move_gen.update_cont_history(prev_piece, prev_to, ss->moved_piece, move.to(), cont_1);
-                    move_gen.update_cont_history2(prev_piece2, prev_to2, ss->moved_piece, move.to(), cont_2);
+                    move_gen.update_cont_history(cont_hist_row, ss->moved_piece, move.to(), cont_1);
+                    move_gen.update_cont_history2(cont_hist2_row, ss->moved_piece, move.to(), cont_2);
                 }
 
             } else if (value <= alpha && !is_capture){
-                move_gen.update_cont_history(prev_piece, prev_to, ss->moved_piece, move.to(), -cont_3);
-                move_gen.update_cont_history2(prev_piece2, prev_to2, ss->moved_piece, move.to(), -cont_4);
+                move_gen.update_cont_history(cont_hist_row, ss->moved_piece, move.to(), -cont_3);
+                move_gen.update_cont_history2(cont_hist2_row, ss->moved_piece, move.to(), -cont_4);
             }
 
         } else if (!pv || move_gen.index() > 1){
@@ -713,18 +922,21 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
             return NO_VALUE;
 
         if (root_node)
-            root_moves[move_gen.index() - 1].setScore(value);
+            root_moves[pv_idx + move_gen.index() - 1].setScore(value);
 
         if (value > max_value){
             assert(is_valid(value));
             max_value = value;
-            if (value > alpha)
+            if (value > alpha){
                 best_move = move;
+                if (pv)
+                    pv_table[ply].update(move, pv_table[ply + 1]);
+            }
             if (root_node){
                 // ! This preserves the order of the array after the current move.
-                // ! Rotate invalidates root_moves[move_gen.index() - 1].
-                std::rotate(root_moves.begin(), root_moves.begin() + move_gen.index() - 1,
-                    root_moves.begin() + move_gen.index());
+                // ! Rotate invalidates root_moves[pv_idx + move_gen.index() - 1].
+                std::rotate(root_moves.begin() + pv_idx, root_moves.begin() + pv_idx + move_gen.index() - 1,
+                    root_moves.begin() + pv_idx + move_gen.index());
             }
         }
 
@@ -774,7 +986,7 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
 
     if (max_value <= initial_alpha && !(ss - 1)->curr_move_capture){
         move_gen.update_cont_history(
-            (ss - 2)->moved_piece, ((ss - 2)->curr_move).to(), prev_piece, prev_to, std::min(depth*cont_5 + cont_6, cont_7));
+            (ss - 2)->cont_hist_row, prev_piece, prev_to, std::min(depth*cont_5 + cont_6, cont_7));
     }
 
 
@@ -808,8 +1020,10 @@ int Engine::negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode){
 
     assert(is_valid(max_value));
 
-    tt.store(zobrist_hash, to_tt(max_value, ply), uncorrected_static_eval, depth, best_move,
-        node_type, pos.fullMoveNumber(), transposition.ttpv);
+    // the root moves of the other multipv lines exclude the best one
+    if (!(root_node && pv_idx > 0))
+        tt.store(zobrist_hash, to_tt(max_value, ply), uncorrected_static_eval, depth, best_move,
+            node_type, transposition.ttpv);
 
     return max_value;
 }
@@ -824,10 +1038,12 @@ int Engine::qsearch(int alpha, int beta, int depth, Stack* ss){
     const int ply = ss - root_ss;
     assert(ply < MAX_PLY); // avoid stack overflow
 
+    if (pv)
+        pv_table[ply].clear();
 
-    if (interrupt_flag || ((nodes & 2047) == 0 && update_interrupt_flag()))
+    if (interrupt_flag || (nodes.get() >= next_limit_check && update_interrupt_flag()))
         return NO_VALUE;
-    nodes.fetch_add(1, std::memory_order_relaxed);
+    nodes.increment();
 
     if (ply > seldepth)
         seldepth = ply;
@@ -842,9 +1058,16 @@ int Engine::qsearch(int alpha, int beta, int depth, Stack* ss){
             return stand_pat;
     }
 
-    if (pos.isHalfMoveDraw() || pos.isInsufficientMaterial() || pos.isRepetition(1) || pos.isRepetition(2)) 
+    if (pos.isHalfMoveDraw() || pos.isInsufficientMaterial() || pos.isRepetition(1))
         return 0;
 
+    // the side to move can force a draw by repeating a position
+    if (alpha < 0 && pos.upcoming_repetition(ply)){
+        alpha = 0;
+        if (alpha >= beta)
+            return alpha;
+    }
+
     if (ply >= MAX_PLY - 1)
         return evaluate(pos);
 
@@ -856,7 +1079,7 @@ int Engine::qsearch(int alpha, int beta, int depth, Stack* ss){
     uint64_t zobrist_hash = pos.hash();
 
     SortedMoveGen capture_gen = SortedMoveGen<GenType::QSEARCH>(
-        (ss - 1)->moved_piece, (ss - 1)->curr_move.to().index(), pos, killer_moves, history, cont_history, capt_history
+        pos, killer_moves, history, cont_history, capt_history
     );
 
     bool is_hit;
@@ -908,7 +1131,7 @@ int Engine::qsearch(int alpha, int beta, int depth, Stack* ss){
         if (stand_pat >= beta){
             if (!is_hit)
                 tt.store(zobrist_hash, to_tt(stand_pat, ply), uncorrected_static_eval,
-                    DEPTH_QSEARCH, Move::NO_MOVE, TFlag::LOWER_BOUND, pos.fullMoveNumber(), transposition.ttpv);
+                    DEPTH_QSEARCH, Move::NO_MOVE, TFlag::LOWER_BOUND, transposition.ttpv);
             return stand_pat;
         }
 
@@ -960,8 +1183,11 @@ int Engine::qsearch(int alpha, int beta, int depth, Stack* ss){
         if (value > max_value){
             assert(is_valid(value));
             max_value = value;
-            if (value > alpha)
+            if (value > alpha){
                 best_move = move;
+                if (pv)
+                    pv_table[ply].update(move, pv_table[ply + 1]);
+            }
         }
 
         alpha = std::max(alpha, value);
@@ -991,7 +1217,7 @@ int Engine::qsearch(int alpha, int beta, int depth, Stack* ss){
         }
 
         tt.store(zobrist_hash, to_tt(stand_pat, ply), NO_VALUE, DEPTH_QSEARCH,
-            Move::NO_MOVE, TFlag::EXACT, pos.fullMoveNumber(), transposition.ttpv);
+            Move::NO_MOVE, TFlag::EXACT, transposition.ttpv);
         return stand_pat;
     }
 
@@ -1006,7 +1232,7 @@ int Engine::qsearch(int alpha, int beta, int depth, Stack* ss){
         tt.store(zobrist_hash, to_tt(max_value, ply),
             uncorrected_static_eval, DEPTH_QSEARCH, best_move,
             max_value >= beta ? TFlag::LOWER_BOUND : TFlag::UPPER_BOUND,
-            pos.fullMoveNumber(), transposition.ttpv);
+            transposition.ttpv);
 
     return max_value;
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <vector>
 #include <chrono>
 #include <atomic>
+#include <thread>
+#include <limits>
 #include "chess.hpp"
 #include "transposition_table.hpp"
 #include "misc.hpp"
@@ -23,10 +25,13 @@ int get_think_time(float time_left, int num_moves_out_of_book,
 class Engine {
     public:
 
-    Engine(bool display_uci, TranspositionTable& tt, std::atomic<int64_t>& nodes);
+    Engine(bool display_uci, TranspositionTable& tt, NodeCounters& search_nodes);
+    ~Engine();
 
     bool display_uci;
-    std::atomic<int64_t>& nodes;
+    int thread_id = 0;
+    NodeCounter nodes; // nodes searched by this thread
+    NodeCounters& search_nodes; // nodes searched by all threads
     int64_t tb_hits = 0;
     int64_t seldepth = 0;
     int root_depth = 0;
@@ -46,14 +51,25 @@ class Engine {
     void update_run_time();
 
     Move iterative_deepening(SearchLimit limit);
+    SearchLimit adjust_limit(SearchLimit limit);
 
     void clear_state();
+    void clear_histories();
 
     void save_state(std::string file);
     void load_state(std::string file);
 
     std::atomic<bool> is_nonsense = false;
 
+    // number of root moves reported with their own line
+    int multi_pv = 1;
+
+    // lazy smp state. helpers is only filled on the main thread, while a search runs.
+    std::vector<Engine*> helpers;
+    std::atomic<bool> searching = false;
+    int completed_depth = 0;
+    Move completed_move = Move::NO_MOVE;
+
     private:
     friend class WorkerPool;
 
@@ -76,8 +92,24 @@ class Engine {
 
     int get_corrhist(Color color);
 
+    int64_t next_limit_check = 0; // node count at which the search limit is checked next
     bool update_interrupt_flag();
-    std::pair<std::string, std::string> get_pv_pmove();
+
+    // lines collected by negamax<true> and qsearch<true>, indexed by ply
+    PVLine pv_table[MAX_PLY + 1];
+    // last complete line of each root move that had one
+    std::vector<PVLine> root_pvs;
+    // the multipv line being searched. the root moves before it are skipped
+    int pv_idx = 0;
+
+    void save_root_pv(Move root_move);
+    const PVLine* find_root_pv(Move root_move);
+    std::string pv_string(Move root_move);
+    std::string ponder_move_string(Move root_move);
+    void print_info(int line, Move root_move, int depth, int num_lines, const std::string& pv);
+
+    bool skip_depth(int depth);
+    Move vote_best_move(Move best_move);
 
     template<bool pv>
     int negamax(int depth, int alpha, int beta, Stack* ss, bool cutnode);
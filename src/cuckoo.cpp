@@ -0,0 +1,58 @@
+#include "cuckoo.hpp"
+
+namespace Cuckoo {
+
+std::array<Entry, SIZE> table;
+
+Bitboard attacks_from(PieceType pt, Square sq, Bitboard occupied){
+    if (pt == PieceType::KNIGHT) return attacks::knight(sq);
+    if (pt == PieceType::BISHOP) return attacks::bishop(sq, occupied);
+    if (pt == PieceType::ROOK) return attacks::rook(sq, occupied);
+    if (pt == PieceType::QUEEN) return attacks::queen(sq, occupied);
+    return attacks::king(sq);
+}
+
+// squares strictly between s1 and s2, empty unless they share a line
+Bitboard between(Square s1, Square s2){
+    for (PieceType pt: {PieceType::BISHOP, PieceType::ROOK}){
+        if (attacks_from(pt, s1, 0).check(s2.index()))
+            return attacks_from(pt, s1, Bitboard::fromSquare(s2)) & attacks_from(pt, s2, Bitboard::fromSquare(s1));
+    }
+    return 0;
+}
+
+void init(){
+    table.fill(Entry());
+
+    [[maybe_unused]] int count = 0;
+    for (Color color: {Color::WHITE, Color::BLACK}){
+        for (PieceType pt: {PieceType::KNIGHT, PieceType::BISHOP, PieceType::ROOK, PieceType::QUEEN, PieceType::KING}){
+            Piece piece = Piece(pt, color);
+            for (int s1 = 0; s1 < 64; s1++){
+                for (int s2 = s1 + 1; s2 < 64; s2++){
+                    if (!attacks_from(pt, s1, 0).check(s2))
+                        continue;
+
+                    // a move and its reverse share an entry
+                    Entry entry;
+                    entry.key = Zobrist::piece(piece, s1) ^ Zobrist::piece(piece, s2) ^ Zobrist::sideToMove();
+                    entry.move = Move::make(s1, s2);
+                    entry.between = between(s1, s2);
+
+                    // insert, pushing the entries out of the way to their other slot
+                    int i = h1(entry.key);
+                    while (true){
+                        std::swap(table[i], entry);
+                        if (entry.move == Move::NO_MOVE)
+                            break;
+                        i = (i == h1(entry.key)) ? h2(entry.key) : h1(entry.key);
+                    }
+                    count++;
+                }
+            }
+        }
+    }
+    assert(count == 3668);
+}
+
+} // namespace Cuckoo
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "chess.hpp"
+
+using namespace chess;
+
+// cuckoo tables of all the reversible moves of non pawn pieces, keyed by the zobrist
+// difference they make. used to detect that a move can repeat a previous position.
+// see https://web.archive.org/web/20201107002606/https://marcelk.net/2013-04-06/paper/upcoming-rep-v2.pdf
+namespace Cuckoo {
+
+constexpr int SIZE = 8192;
+
+struct Entry {
+    uint64_t key = 0;
+    Move move = Move::NO_MOVE;
+    Bitboard between = 0; // squares the piece passes through
+};
+
+extern std::array<Entry, SIZE> table;
+
+inline int h1(uint64_t key){ return key & (SIZE - 1); }
+inline int h2(uint64_t key){ return (key >> 16) & (SIZE - 1); }
+
+// fills the tables, must be called once before searching
+void init();
+
+// returns the entry of the move with the given zobrist difference, or nullptr.
+inline const Entry* probe(uint64_t move_key){
+    const Entry* entry = &table[h1(move_key)];
+    if (entry->key == move_key)
+        return entry;
+
+    entry = &table[h2(move_key)];
+    if (entry->key == move_key)
+        return entry;
+
+    return nullptr;
+}
+
+} // namespace Cuckoo
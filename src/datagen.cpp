@@ -19,6 +19,7 @@ void genfens(Engine& engine, std::mt19937 rng, int count){
             board.isGameOver().second != GameResult::NONE
             || [&]() {
                 engine.pos.setFen(board.getFen());
+                engine.tt.new_search();
                 int value = engine.iterative_deepening(SearchLimit(LimitType::Depth, GENFENS_FILTER_DEPTH)).score();
                 return std::abs(value) > GENFENS_MAX_VALUE;
             }()
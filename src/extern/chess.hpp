@@ -302,7 +302,7 @@ class Square {
     // clang-format on
 
 // when c++20
-#if (__cplusplus >= 202002L && __GNUC__ >= 12) || (defined(_MSC_VER) && _MSVC_LANG >= 202002L)
+#if (__cplusplus >= 202002L && __GNUC__ >= 13) || (defined(_MSC_VER) && _MSVC_LANG >= 202002L)
     using enum underlying;
 #else
 
@@ -1728,6 +1728,7 @@ class Zobrist {
 
     static constexpr int MAP_HASH_PIECE[12] = {1, 3, 5, 7, 9, 11, 0, 2, 4, 6, 8, 10};
 
+   public:
     [[nodiscard]] static U64 piece(Piece piece, Square square) noexcept {
         assert(piece < 12);
         return RANDOM_ARRAY[64 * MAP_HASH_PIECE[piece] + square.index()];
@@ -1871,6 +1872,8 @@ class Board {
         std::uint8_t half_moves;
         Piece captured_piece;
 
+        State() = default;
+
         State(const U64& hash, const uint16_t& pawn_key, const uint16_t& minor_key, const uint16_t& major_key,
               const uint16_t (&nonpawn_key)[2], const CastlingRights& castling, const Square& enpassant,
               const std::uint8_t& half_moves, const Piece& captured_piece)
@@ -1887,6 +1890,61 @@ class Board {
               }
     };
 
+    // the states of the previous positions, stored inline so that making a move never allocates
+    // and copying a board only copies the states in use. the capacity covers a long game plus
+    // the search. when it is full, the oldest half is dropped: those positions can no longer be
+    // unmade, but repetitions never reach that far back past an irreversible move.
+    class StateStack {
+       public:
+        static constexpr std::size_t CAPACITY = 1024;
+
+        StateStack() = default;
+
+        StateStack(const StateStack& other) : size_(other.size_) {
+            std::copy_n(other.states_, size_, states_);
+        }
+
+        StateStack& operator=(const StateStack& other) {
+            size_ = other.size_;
+            std::copy_n(other.states_, size_, states_);
+            return *this;
+        }
+
+        template <typename... Args>
+        void emplace_back(Args&&... args) {
+            if (size_ == CAPACITY) drop_oldest();
+            states_[size_++] = State(std::forward<Args>(args)...);
+        }
+
+        void pop_back() noexcept {
+            assert(size_ > 0);
+            size_--;
+        }
+
+        [[nodiscard]] const State& back() const noexcept {
+            assert(size_ > 0);
+            return states_[size_ - 1];
+        }
+
+        [[nodiscard]] const State& operator[](std::size_t idx) const noexcept {
+            assert(idx < size_);
+            return states_[idx];
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+        void clear() noexcept { size_ = 0; }
+
+       private:
+        void drop_oldest() noexcept {
+            std::copy(states_ + CAPACITY / 2, states_ + CAPACITY, states_);
+            size_ = CAPACITY / 2;
+        }
+
+        std::size_t size_ = 0;
+        State states_[CAPACITY];
+    };
+
    protected:
     enum class ProtectedCtor { CREATE };
 
@@ -1895,7 +1953,6 @@ class Board {
 
    public:
     explicit Board(std::string_view fen = constants::STARTPOS, bool chess960 = false) {
-        prev_states_.reserve(256);
         chess960_ = chess960;
         assert(setFenInternal<true>(constants::STARTPOS));
         setFenInternal<true>(fen);
@@ -1918,7 +1975,7 @@ class Board {
      * @param fen
      * @return
      */
-    virtual bool setFen(std::string_view fen) { return setFenInternal(fen); }
+    bool setFen(std::string_view fen) { return setFenInternal(fen); }
 
     /**
      * @brief Parse and set a position from xFEN (Chess960/Shredder-FEN style castling).
@@ -3200,11 +3257,12 @@ class Board {
     }
 
    protected:
-    virtual void placePiece(Piece piece, Square sq) { placePieceInternal(piece, sq); }
+    // not virtual, so that makeMove and unmakeMove inline them in the search.
+    void placePiece(Piece piece, Square sq) { placePieceInternal(piece, sq); }
 
-    virtual void removePiece(Piece piece, Square sq) { removePieceInternal(piece, sq); }
+    void removePiece(Piece piece, Square sq) { removePieceInternal(piece, sq); }
 
-    std::vector<State> prev_states_;
+    StateStack prev_states_;
 
     std::array<Bitboard, 6> pieces_bb_ = {};
     std::array<Bitboard, 2> occ_bb_    = {};
@@ -1,6 +1,6 @@
 #include "history.hpp"
 
-int& ContinuationHistory::get(Piece prev_piece, Square prev_to, Piece piece, Square to){
+int16_t& ContinuationHistory::get(Piece prev_piece, Square prev_to, Piece piece, Square to){
     return this->history[
         prev_piece * NUM_SQUARES * NUM_PIECES * NUM_SQUARES
       + prev_to.index() * NUM_PIECES * NUM_SQUARES
@@ -9,7 +9,14 @@ int& ContinuationHistory::get(Piece prev_piece, Square prev_to, Piece piece, Squ
     ];
 }
 
-int& FromToHistory::get(Color color, Square from, Square to){
+int16_t* ContinuationHistory::row(Piece prev_piece, Square prev_to){
+    return &this->history[
+        prev_piece * NUM_SQUARES * NUM_PIECES * NUM_SQUARES
+      + prev_to.index() * NUM_PIECES * NUM_SQUARES
+    ];
+}
+
+int16_t& FromToHistory::get(Color color, Square from, Square to){
     return this->history[
         color * NUM_SQUARES * NUM_SQUARES
       + from.index() * NUM_SQUARES
@@ -17,7 +24,7 @@ int& FromToHistory::get(Color color, Square from, Square to){
     ];
 }
 
-int& CaptureHistory::get(Piece piece, Square to, Piece captured){
+int16_t& CaptureHistory::get(Piece piece, Square to, Piece captured){
     // if the move was en passant, this function may be called with captured == None,
     // but idx will still be less than the history size
     int idx = piece * NUM_SQUARES * NUM_PIECETYPES 
@@ -28,18 +35,18 @@ int& CaptureHistory::get(Piece piece, Square to, Piece captured){
     return history[idx];
 }
 
-int& PawnCorrectionHistory::get(Color color, uint16_t key){
+int16_t& PawnCorrectionHistory::get(Color color, uint16_t key){
     return this->history[NUM_COLORS * (key % PAWN_CORRHIST_SIZE) + color];
 }
 
-int& MinorCorrectionHistory::get(Color color, uint16_t key){
+int16_t& MinorCorrectionHistory::get(Color color, uint16_t key){
     return this->history[NUM_COLORS * (key % MINOR_CORRHIST_SIZE) + color];
 }
 
-int& MajorCorrectionHistory::get(Color color, uint16_t key){
+int16_t& MajorCorrectionHistory::get(Color color, uint16_t key){
     return this->history[NUM_COLORS * (key % MAJOR_CORRHIST_SIZE) + color];
 }
 
-int& NonPawnCorrectionHistory::get(Color color, uint16_t key){
+int16_t& NonPawnCorrectionHistory::get(Color color, uint16_t key){
     return this->history[NUM_COLORS * (key % NONPAWN_CORRHIST_SIZE) + color];
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include <fstream>
 #include <array>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include "constants.hpp"
 #include "tune.hpp"
 #include "chess.hpp"
@@ -24,6 +27,7 @@ UNACTIVE_TUNEABLE(MAX_MINOR_CORRHIST_BONUS, int, 8662, 0, 50'000, 1600, 0.002);
 UNACTIVE_TUNEABLE(MAX_MAJOR_CORRHIST_BONUS, int, 8286, 0, 50'000, 1600, 0.002);
 UNACTIVE_TUNEABLE(MAX_NONPAWN_CORRHIST_BONUS, int, 7757, 0, 50'000, 1600, 0.002);
 
+// entries are stored as int16_t to halve the memory touched by the search.
 template <std::size_t size>
 class HistoryBase {
     public:
@@ -36,70 +40,78 @@ class HistoryBase {
         std::fill(std::begin(history), std::end(history), fill_value);
     }
 
-    void apply_bonus(int& value, int bonus){
-        value += bonus - value * std::abs(bonus) / max_bonus;
+    // the gravity term keeps values within max_bonus, the result only saturates
+    // when max_bonus is tuned beyond the range of int16_t.
+    void apply_bonus(int16_t& value, int bonus){
+        int new_value = value + bonus - value * std::abs(bonus) / max_bonus;
+        value = std::clamp<int>(new_value, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
     }
 
     void save_to_stream(std::ofstream& ofs){
-        for (const auto& v : history)
-            ofs.write(reinterpret_cast<const char*>(&v), sizeof(int));
+        ofs.write(reinterpret_cast<const char*>(history.data()), sizeof(history));
     }
 
     void load_from_stream(std::ifstream& ifs){
-        for (auto& v : history)
-            ifs.read(reinterpret_cast<char*>(&v), sizeof(int));
+        ifs.read(reinterpret_cast<char*>(history.data()), sizeof(history));
     }
 
     const int& fill_value;
     const int& max_bonus;
-    std::array<int, size> history = {};
+    std::array<int16_t, size> history = {};
 };
 
 class ContinuationHistory: public HistoryBase<NUM_PIECES * NUM_SQUARES * NUM_PIECES * NUM_SQUARES> {
     public:
     ContinuationHistory(): HistoryBase(CONTHIST_FILL_VALUE, MAX_CONTHIST_BONUS) {}
 
-    int& get(Piece prev_piece, Square prev_to, Piece piece, Square to);
+    int16_t& get(Piece prev_piece, Square prev_to, Piece piece, Square to);
+
+    // entries of the moves following (prev_piece, prev_to), to be used with get(row, piece, to).
+    int16_t* row(Piece prev_piece, Square prev_to);
+
+    static int16_t& get(int16_t* row, Piece piece, Square to){
+        return row[piece * NUM_SQUARES + to.index()];
+    }
 };
 
 class FromToHistory: public HistoryBase<NUM_COLORS * NUM_SQUARES * NUM_SQUARES> {
     public:
     FromToHistory(): HistoryBase(HIST_FILL_VALUE, MAX_HIST_BONUS) {}
 
-    int& get(Color color, Square from, Square to);
+    int16_t& get(Color color, Square from, Square to);
 };
 
 class CaptureHistory: public HistoryBase<NUM_PIECES * NUM_SQUARES * NUM_PIECETYPES> {
     public:
     CaptureHistory(): HistoryBase(CAPTHIST_FILL_VALUE, MAX_CAPTHIST_BONUS) {}
 
-    int& get(Piece piece, Square to, Piece captured);
+    int16_t& get(Piece piece, Square to, Piece captured);
 };
 
 class PawnCorrectionHistory: public HistoryBase<NUM_COLORS * PAWN_CORRHIST_SIZE> {
     public:
     PawnCorrectionHistory(): HistoryBase(PAWN_CORRHIST_FILL_VALUE, MAX_PAWN_CORRHIST_BONUS) {}
 
-    int& get(Color color, uint16_t key);
+    int16_t& get(Color color, uint16_t key);
 };
 
 class MinorCorrectionHistory: public HistoryBase<NUM_COLORS * MINOR_CORRHIST_SIZE> {
     public:
     MinorCorrectionHistory(): HistoryBase(MINOR_CORRHIST_FILL_VALUE, MAX_MINOR_CORRHIST_BONUS) {}
 
-    int& get(Color color, uint16_t key);
+    int16_t& get(Color color, uint16_t key);
 };
 
 class MajorCorrectionHistory: public HistoryBase<NUM_COLORS * MAJOR_CORRHIST_SIZE> {
     public:
     MajorCorrectionHistory(): HistoryBase(MAJOR_CORRHIST_FILL_VALUE, MAX_MAJOR_CORRHIST_BONUS) {}
 
-    int& get(Color color, uint16_t key);
+    int16_t& get(Color color, uint16_t key);
 };
 
 class NonPawnCorrectionHistory: public HistoryBase<NUM_COLORS * NONPAWN_CORRHIST_SIZE> {
     public:
     NonPawnCorrectionHistory(): HistoryBase(NONPAWN_CORRHIST_FILL_VALUE, MAX_NONPAWN_CORRHIST_BONUS) {}
 
-    int& get(Color color, uint16_t key);
+    int16_t& get(Color color, uint16_t key);
 };
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 int main(int argc, char* argv[]){
     NNUE::init();
+    Cuckoo::init();
 
     UCIAgent uci_engine = UCIAgent();
     Engine& engine = uci_engine.workers.main().engine;
@@ -31,6 +32,8 @@ int main(int argc, char* argv[]){
         }
     }
 
+    std::cout << "info string hash uses " << Memory::page_type_name(uci_engine.tt.get_page_type()) << std::endl;
+
     std::string input;
     bool running;
     do {
@@ -0,0 +1,186 @@
+#include "memory.hpp"
+
+#include <cstdint>
+
+#if defined(__linux__)
+    #include <fstream>
+    #include <sstream>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#else
+    #include <fstream>
+#endif
+
+namespace Memory {
+
+size_t round_up(size_t size){
+    return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+#if defined(__linux__)
+
+void* allocate_large(size_t size, bool use_huge_pages, PageType& page_type){
+    size = round_up(size);
+
+    // anonymous mappings are zeroed by the kernel, and pages are only placed on a NUMA node
+    // once they are first written to.
+    if (use_huge_pages){
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (ptr != MAP_FAILED){
+            page_type = PageType::HUGE;
+            return ptr;
+        }
+    }
+
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        return nullptr;
+
+    page_type = PageType::DEFAULT;
+
+#if defined(MADV_HUGEPAGE)
+    if (use_huge_pages && madvise(ptr, size, MADV_HUGEPAGE) == 0)
+        page_type = PageType::TRANSPARENT_HUGE;
+#endif
+
+    return ptr;
+}
+
+void free_large(void* ptr, size_t size){
+    if (ptr != nullptr)
+        munmap(ptr, round_up(size));
+}
+
+// madvise succeeds even when transparent huge pages are disabled, so the AnonHugePages
+// field of the mapping is read from /proc/self/smaps.
+void confirm_page_type(const void* ptr, PageType& page_type){
+    if (page_type != PageType::TRANSPARENT_HUGE)
+        return;
+
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool in_mapping = false;
+    while (std::getline(smaps, line)){
+        std::istringstream fields(line);
+        std::string name;
+        if (!(fields >> name))
+            continue;
+
+        // mapping headers start with "start-end", field lines with "Name:"
+        if (name.back() != ':'){
+            in_mapping = std::stoull(name, nullptr, 16) == reinterpret_cast<uintptr_t>(ptr);
+            continue;
+        }
+
+        if (in_mapping && name == "AnonHugePages:"){
+            size_t huge_kb = 0;
+            fields >> huge_kb;
+            if (huge_kb == 0)
+                page_type = PageType::DEFAULT;
+            return;
+        }
+    }
+
+    // the mapping was not found, nothing is known about its pages
+    page_type = PageType::DEFAULT;
+}
+
+#else
+
+void* allocate_large(size_t size, bool use_huge_pages, PageType& page_type){
+    size = round_up(size);
+    page_type = PageType::DEFAULT;
+
+#if defined(_WIN32)
+    void* ptr = _aligned_malloc(size, HUGE_PAGE_SIZE);
+#else
+    void* ptr = std::aligned_alloc(HUGE_PAGE_SIZE, size);
+#endif
+
+    if (ptr != nullptr)
+        std::memset(ptr, 0, size);
+    return ptr;
+}
+
+void confirm_page_type(const void* ptr, PageType& page_type){}
+
+void free_large(void* ptr, size_t size){
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+#endif
+
+std::string page_type_name(PageType page_type){
+    switch (page_type){
+        case PageType::HUGE:
+            return "huge pages";
+        case PageType::TRANSPARENT_HUGE:
+            return "transparent huge pages";
+        default:
+            return "default pages";
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+const void* map_file(const std::string& path, size_t& size){
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size == 0){
+        close(fd);
+        return nullptr;
+    }
+    size = file_stat.st_size;
+
+    // the mapping stays valid once the file is closed.
+    void* ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+void unmap_file(const void* ptr, size_t size){
+    if (ptr != nullptr)
+        munmap(const_cast<void*>(ptr), size);
+}
+
+#else
+
+// without mmap, the file is read into private memory.
+const void* map_file(const std::string& path, size_t& size){
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+    if (!ifs)
+        return nullptr;
+
+    size = ifs.tellg();
+    ifs.seekg(0);
+
+    PageType page_type;
+    void* ptr = allocate_large(size, false, page_type);
+    if (ptr != nullptr && !ifs.read(static_cast<char*>(ptr), size)){
+        free_large(ptr, size);
+        return nullptr;
+    }
+    return ptr;
+}
+
+void unmap_file(const void* ptr, size_t size){
+    free_large(const_cast<void*>(ptr), size);
+}
+
+#endif
+
+} // namespace Memory
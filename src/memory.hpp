@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace Memory {
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+enum class PageType {
+    DEFAULT,
+    TRANSPARENT_HUGE, // madvise hint, the kernel may back the memory with huge pages
+    HUGE, // explicit huge pages reserved with MAP_HUGETLB
+};
+
+// returns zeroed memory aligned to a huge page boundary.
+// huge pages are requested when use_huge_pages is set, page_type reports what was obtained.
+void* allocate_large(size_t size, bool use_huge_pages, PageType& page_type);
+void free_large(void* ptr, size_t size);
+
+// transparent huge pages are only a hint. once the memory from allocate_large has been
+// written to, this falls back to PageType::DEFAULT if none of it is backed by huge pages.
+void confirm_page_type(const void* ptr, PageType& page_type);
+
+std::string page_type_name(PageType page_type);
+
+// maps a file read-only, returns nullptr on failure. processes mapping the
+// same file share its pages.
+const void* map_file(const std::string& path, size_t& size);
+void unmap_file(const void* ptr, size_t size);
+
+} // namespace Memory
@@ -71,4 +71,18 @@ std::vector<std::string> split_string(std::string str) {
         split.push_back(curr);
 
     return split;
-}
\ No newline at end of file
+}
+void NodeCounters::add(NodeCounter* counter){
+    counters.push_back(counter);
+}
+
+void NodeCounters::remove(NodeCounter* counter){
+    counters.erase(std::remove(counters.begin(), counters.end(), counter), counters.end());
+}
+
+int64_t NodeCounters::total(){
+    int64_t sum = 0;
+    for (NodeCounter* counter: counters)
+        sum += counter->get();
+    return sum;
+}
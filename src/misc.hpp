@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <algorithm>
 #include <sstream>
 #include <fstream>
 #include <vector>
@@ -24,10 +26,29 @@ struct Stack {
     Move curr_move = Move::NO_MOVE;
     bool curr_move_capture = false;
     Piece moved_piece = Piece::NONE;
+    // rows of cont_history and cont_history2 selected by the move made at this ply,
+    // null if no piece was moved.
+    int16_t* cont_hist_row = nullptr;
+    int16_t* cont_hist2_row = nullptr;
     int static_eval = NO_VALUE;
     int reduction = 0;
 };
 
+// a principal variation. the search keeps one per ply, each made of the move
+// of its ply followed by the line of the next ply.
+struct PVLine {
+    std::array<Move, MAX_PLY + 1> moves;
+    int length = 0;
+
+    void clear(){ length = 0; }
+
+    void update(Move move, const PVLine& next){
+        moves[0] = move;
+        std::copy(next.moves.begin(), next.moves.begin() + next.length, moves.begin() + 1);
+        length = next.length + 1;
+    }
+};
+
 class KillerMoves {
     public:
     uint16_t moves[ENGINE_MAX_DEPTH][3];
@@ -40,6 +61,38 @@ class KillerMoves {
     void load_from_stream(std::ifstream& ifs);
 };
 
+// nodes searched by one thread. it sits alone on a cache line and is only
+// written by its owning thread, so counting nodes never contends between threads.
+class alignas(64) NodeCounter {
+    public:
+    void increment(){
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    };
+
+    void reset(){
+        count.store(0, std::memory_order_relaxed);
+    };
+
+    int64_t get() const {
+        return count.load(std::memory_order_relaxed);
+    };
+
+    private:
+    std::atomic<int64_t> count = 0;
+};
+
+// the node counters of all the threads of a search, summed on demand.
+// counters are added and removed only while no search is running.
+class NodeCounters {
+    public:
+    void add(NodeCounter* counter);
+    void remove(NodeCounter* counter);
+    int64_t total();
+
+    private:
+    std::vector<NodeCounter*> counters;
+};
+
 enum LimitType {
     Time,
     Depth,
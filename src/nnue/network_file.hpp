@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "constants.hpp"
+
+// a network file holds a header followed by the network in the layout used for
+// inference, as written by utils/prepare_network.cpp, so it can be mapped and used in place.
+namespace NetworkFile {
+
+constexpr char MAGIC[8] = {'B', 'R', 'E', 'A', 'D', 'N', 'E', 'T'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t ALIGNMENT = 64;
+
+struct alignas(ALIGNMENT) Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t l1_block_size; // number of rows in the layer 1 weight blocks
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+constexpr size_t align(size_t size){
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// offsets of the parameters in the payload, which starts right after the header.
+constexpr size_t FT_WEIGHTS_OFFSET = 0;
+constexpr size_t FT_BIAS_OFFSET = FT_WEIGHTS_OFFSET + align(sizeof(int16_t) * L0_WEIGHTS_SIZE);
+constexpr size_t L1_WEIGHTS_OFFSET = FT_BIAS_OFFSET + align(sizeof(int16_t) * L0_BIAS_SIZE);
+constexpr size_t L1_BIAS_OFFSET = L1_WEIGHTS_OFFSET + align(sizeof(int8_t) * BUCKETED_L1_WEIGHTS_SIZE);
+constexpr size_t L2_WEIGHTS_OFFSET = L1_BIAS_OFFSET + align(sizeof(int32_t) * BUCKETED_L1_BIAS_SIZE);
+constexpr size_t L2_BIAS_OFFSET = L2_WEIGHTS_OFFSET + align(sizeof(int16_t) * BUCKETED_L2_WEIGHTS_SIZE);
+constexpr size_t PAYLOAD_SIZE = L2_BIAS_OFFSET + align(sizeof(int32_t) * BUCKETED_L2_BIAS_SIZE);
+
+constexpr size_t FILE_SIZE = sizeof(Header) + PAYLOAD_SIZE;
+
+// 64 bit fnv-1a, applied to 8 byte words. size must be a multiple of 8.
+inline uint64_t checksum(const uint8_t* data, size_t size){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i += 8){
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash ^= word;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+}; // namespace NetworkFile
@@ -1,4 +1,6 @@
 #include "nnue.hpp"
+#include "network_file.hpp"
+#include "memory.hpp"
  
 #if !defined(_MSC_VER)
     constexpr
@@ -46,14 +48,14 @@
             ".byte 0\n" \
     ); \
 
-INCBIN(ft_weights, bread_NNUE_MODEL_PATH "/feature_transformer/weights.bin");
-INCBIN(ft_bias, bread_NNUE_MODEL_PATH "/feature_transformer/bias.bin");
+INCBIN(ft_weights, bread_NNUE_PREPARED_MODEL_PATH "/feature_transformer/weights.bin");
+INCBIN(ft_bias, bread_NNUE_PREPARED_MODEL_PATH "/feature_transformer/bias.bin");
 
-INCBIN(l1_weights, bread_NNUE_MODEL_PATH "/layer_1/weights.bin");
-INCBIN(l1_bias, bread_NNUE_MODEL_PATH "/layer_1/bias.bin");
+INCBIN(l1_weights, bread_NNUE_PREPARED_MODEL_PATH "/layer_1/weights.bin");
+INCBIN(l1_bias, bread_NNUE_PREPARED_MODEL_PATH "/layer_1/bias.bin");
 
-INCBIN(l2_weights, bread_NNUE_MODEL_PATH "/layer_2/weights.bin");
-INCBIN(l2_bias, bread_NNUE_MODEL_PATH "/layer_2/bias.bin");
+INCBIN(l2_weights, bread_NNUE_PREPARED_MODEL_PATH "/layer_2/weights.bin");
+INCBIN(l2_bias, bread_NNUE_PREPARED_MODEL_PATH "/layer_2/bias.bin");
 
 extern "C" {
     extern const int16_t ft_weights_start[];
@@ -76,98 +78,112 @@ NNUE implementation
 
 namespace NNUE {
 
-int16_t* ft_weights = nullptr;
-int16_t* ft_bias    = nullptr;
+const int16_t* ft_weights = nullptr;
+const int16_t* ft_bias    = nullptr;
 
-int8_t* l1_weights = nullptr;
-int32_t* l1_bias    = nullptr;
+const int8_t* l1_weights = nullptr;
+const int32_t* l1_bias    = nullptr;
 
-int16_t* l2_weights = nullptr;
-int32_t* l2_bias    = nullptr;
+const int16_t* l2_weights = nullptr;
+const int32_t* l2_bias    = nullptr;
 
-alignas(32) uint8_t ft_clamped_output[L1_INPUT_SIZE];
+alignas(32) int16_t nnz_lookup[256][8];
 
-alignas(32) int32_t l1_output[L1_OUTPUT_SIZE];
-alignas(32) int16_t l1_clamped_output[L1_OUTPUT_SIZE];
+// the kernels for the instruction set of the cpu, chosen in init.
+const Kernels::Table* kernels = &Kernels::sse41::table;
 
-alignas(32) int16_t nnz_lookup[256][8];
+std::vector<const Kernels::Table*> supported_kernels(){
+    __builtin_cpu_init();
+
+    std::vector<const Kernels::Table*> tables;
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+     && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")
+     && __builtin_cpu_supports("avx512vnni"))
+        tables.push_back(&Kernels::avx512_vnni::table);
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("avxvnni"))
+        tables.push_back(&Kernels::avx2_vnni::table);
+
+    if (__builtin_cpu_supports("avx2"))
+        tables.push_back(&Kernels::avx2::table);
+
+    tables.push_back(&Kernels::sse41::table);
+    return tables;
+}
+
+void set_kernels(const Kernels::Table& table){
+    kernels = &table;
+}
+
+// the network file currently in use, if any.
+const void* network_file = nullptr;
+size_t network_file_size = 0;
 
+// the embedded network is already in the layout used for inference (see utils/prepare_network.cpp),
+// so it is used in place.
 void load_model(){
-    // feature transformer
-    for (int a = 0; a < INPUT_SIZE; a++){
-        for (int j = 0; j < ACC_SIZE / 2; j++){
-            ft_weights[a * ACC_SIZE + j] = ft_weights_start[a * ACC_SIZE + FT_PERMUTATION[j]];
-            ft_weights[a * ACC_SIZE + ACC_SIZE / 2 + j] = ft_weights_start[a * ACC_SIZE + ACC_SIZE / 2 + FT_PERMUTATION[j]];
-        }
-    }
+    Memory::unmap_file(network_file, network_file_size);
+    network_file = nullptr;
 
-    for (int j = 0; j < ACC_SIZE / 2; j++){
-        ft_bias[j] = ft_bias_start[FT_PERMUTATION[j]];
-        ft_bias[ACC_SIZE / 2 + j] = ft_bias_start[ACC_SIZE / 2 + FT_PERMUTATION[j]];
-    }
+    ft_weights = ft_weights_start;
+    ft_bias = ft_bias_start;
 
-    // layer 1
-    std::vector<int8_t> permuted_l1(BUCKETED_L1_WEIGHTS_SIZE);
+    l1_weights = l1_weights_start;
+    l1_bias = l1_bias_start;
 
-    for (int bucket = 0; bucket < NUM_OUTPUT_BUCKETS; bucket++){
-        for (int row = 0; row < L1_OUTPUT_SIZE; row++){
-            for (int col = 0; col < ACC_SIZE / 2; col++){
-                permuted_l1[bucket * L1_WEIGHTS_SIZE + row * L1_INPUT_SIZE + col] =
-                    l1_weights_start[bucket * L1_WEIGHTS_SIZE + row * L1_INPUT_SIZE + FT_PERMUTATION[col]];
-
-                permuted_l1[bucket * L1_WEIGHTS_SIZE + row * L1_INPUT_SIZE + ACC_SIZE / 2 + col] =
-                    l1_weights_start[bucket * L1_WEIGHTS_SIZE + row * L1_INPUT_SIZE + ACC_SIZE / 2 + FT_PERMUTATION[col]];
-            }
-        }
-    }
+    l2_weights = l2_weights_start;
+    l2_bias = l2_bias_start;
+};
 
-    // permute weights
-    int idx = 0;
-    for (int bucket = 0; bucket < NUM_OUTPUT_BUCKETS; bucket++)
-        for (int row_block = 0; row_block < L1_OUTPUT_SIZE; row_block += INT32_PER_REG)
-            for (int col_block = 0; col_block < L1_INPUT_SIZE; col_block += 4)
-                for (int m = 0; m < INT32_PER_REG; m++)                 // row within block
-                    for (int n = 0; n < 4; n++)                         // col within block
-                        l1_weights[idx++] = permuted_l1[
-                            bucket * L1_WEIGHTS_SIZE
-                            + (row_block + m) * L1_INPUT_SIZE
-                            + (col_block + n)
-                        ];
-
-    for (int i = 0; i < BUCKETED_L1_BIAS_SIZE; i++)
-        l1_bias[i] = l1_bias_start[i] >> 1;
-
-    // layer 2
-    for (int i = 0; i < BUCKETED_L2_WEIGHTS_SIZE; i++){
-        l2_weights[i] = l2_weights_start[i];
-    }
-    for (int i = 0; i < BUCKETED_L2_BIAS_SIZE; i++){
-        l2_bias[i] = l2_bias_start[i];
+bool load_network_file(const std::string& path, std::string& error){
+    size_t size = 0;
+    const void* data = Memory::map_file(path, size);
+    if (data == nullptr){
+        error = "could not open file";
+        return false;
     }
-};
 
-void init(){
-    ft_weights = static_cast<int16_t*>(
-        operator new[](sizeof(int16_t)*L0_WEIGHTS_SIZE, std::align_val_t{32})
-    );
-    ft_bias = static_cast<int16_t*>(
-        operator new[](sizeof(int16_t)*L0_BIAS_SIZE, std::align_val_t{32})
-    );
+    auto fail = [&](std::string reason){
+        Memory::unmap_file(data, size);
+        error = reason;
+        return false;
+    };
 
-    l1_weights = static_cast<int8_t*>(
-        operator new[](sizeof(int8_t)*BUCKETED_L1_WEIGHTS_SIZE, std::align_val_t{32})
-    );
-    l1_bias = static_cast<int32_t*>(
-        operator new[](sizeof(int32_t)*BUCKETED_L1_BIAS_SIZE, std::align_val_t{32})
-    );
+    if (size != NetworkFile::FILE_SIZE)
+        return fail("unexpected file size");
 
-    l2_weights = static_cast<int16_t*>(
-        operator new[](sizeof(int16_t)*BUCKETED_L2_WEIGHTS_SIZE, std::align_val_t{32})
-    );
-    l2_bias = static_cast<int32_t*>(
-        operator new[](sizeof(int32_t)*BUCKETED_L2_BIAS_SIZE, std::align_val_t{32})
-    );
+    const NetworkFile::Header* header = static_cast<const NetworkFile::Header*>(data);
+    if (std::memcmp(header->magic, NetworkFile::MAGIC, sizeof(header->magic)) != 0)
+        return fail("not a network file");
 
+    if (header->version != NetworkFile::VERSION)
+        return fail("unsupported version " + std::to_string(header->version));
+
+    if (header->l1_block_size != L1_OUTPUT_SIZE || header->payload_size != NetworkFile::PAYLOAD_SIZE)
+        return fail("unsupported layer 1 layout");
+
+    const uint8_t* payload = static_cast<const uint8_t*>(data) + sizeof(NetworkFile::Header);
+    if (NetworkFile::checksum(payload, NetworkFile::PAYLOAD_SIZE) != header->checksum)
+        return fail("checksum mismatch");
+
+    Memory::unmap_file(network_file, network_file_size);
+    network_file = data;
+    network_file_size = size;
+
+    ft_weights = reinterpret_cast<const int16_t*>(payload + NetworkFile::FT_WEIGHTS_OFFSET);
+    ft_bias = reinterpret_cast<const int16_t*>(payload + NetworkFile::FT_BIAS_OFFSET);
+
+    l1_weights = reinterpret_cast<const int8_t*>(payload + NetworkFile::L1_WEIGHTS_OFFSET);
+    l1_bias = reinterpret_cast<const int32_t*>(payload + NetworkFile::L1_BIAS_OFFSET);
+
+    l2_weights = reinterpret_cast<const int16_t*>(payload + NetworkFile::L2_WEIGHTS_OFFSET);
+    l2_bias = reinterpret_cast<const int32_t*>(payload + NetworkFile::L2_BIAS_OFFSET);
+    return true;
+}
+
+void init(){
+    kernels = supported_kernels().front();
     load_model();
 
     for (int i = 0; i < 256; i++){
@@ -187,321 +203,105 @@ void init(){
 };
 
 void cleanup(){
-    operator delete[](ft_weights, std::align_val_t(32));
-    operator delete[](ft_bias, std::align_val_t(32));
-
-    operator delete[](l1_weights, std::align_val_t(32));
-    operator delete[](l1_bias, std::align_val_t(32));
-
-    operator delete[](l2_weights, std::align_val_t(32));
-    operator delete[](l2_bias, std::align_val_t(32));
+    Memory::unmap_file(network_file, network_file_size);
+    network_file = nullptr;
 };
 
-void compute_accumulator(Accumulator& new_acc, const Features active_features){
-    for (int i = 0; i < ACC_SIZE; i += INT16_PER_REG){
-        auto r = load_epi16(&ft_bias[i]);
-
-        for (const int &a: active_features)
-            r = add_epi16(r, load_epi16(&ft_weights[a * ACC_SIZE + i]));
+const char* kernels_name(){
+    return kernels->name;
+}
 
-        store_epi16(&new_acc[i], r);
-    }
-};
+void compute_accumulator(Accumulator& new_acc, const Features& active_features){
+    kernels->compute_accumulator(new_acc, active_features);
+}
 
 void update_accumulator(Accumulator& prev_acc, Accumulator& new_acc, const ModifiedFeatures& m_features){
-    assert(m_features.valid());
-    constexpr int CHUNK_SIZE = NUM_AVX_REGISTERS * INT16_PER_REG;
-
-    switch (m_features.type)
-    {
-    case ModifiedFeatures::NORMAL:
-    {
-        auto* prev = &prev_acc[0];
-        auto* out  = &new_acc[0];
-        auto* w_add = &ft_weights[m_features.added_1 * ACC_SIZE];
-        auto* w_rem = &ft_weights[m_features.removed_1 * ACC_SIZE];
-
-        for (int i = 0; i < ACC_SIZE; i += INT16_PER_REG * 4){ // process 4 registers at once
-            
-            auto r1 = load_epi16(prev + i);
-            auto r2 = load_epi16(prev + i + INT16_PER_REG);
-            auto r3 = load_epi16(prev + i + INT16_PER_REG*2);
-            auto r4 = load_epi16(prev + i + INT16_PER_REG*3);
-
-            r1 = add_epi16(r1, load_epi16(w_add + i));
-            r2 = add_epi16(r2, load_epi16(w_add + i + INT16_PER_REG));
-            r3 = add_epi16(r3, load_epi16(w_add + i + INT16_PER_REG*2));
-            r4 = add_epi16(r4, load_epi16(w_add + i + INT16_PER_REG*3));
-
-            r1 = sub_epi16(r1, load_epi16(w_rem + i));
-            r2 = sub_epi16(r2, load_epi16(w_rem + i + INT16_PER_REG));
-            r3 = sub_epi16(r3, load_epi16(w_rem + i + INT16_PER_REG*2));
-            r4 = sub_epi16(r4, load_epi16(w_rem + i + INT16_PER_REG*3));
-
-            store_epi16(out + i, r1);
-            store_epi16(out + i + INT16_PER_REG, r2);
-            store_epi16(out + i + INT16_PER_REG*2, r3);
-            store_epi16(out + i + INT16_PER_REG*3, r4);
-        }
-        break;
-    }
-    case ModifiedFeatures::CAPTURE:
-        for (int j = 0; j < ACC_SIZE; j += CHUNK_SIZE){
-            auto* prev = &prev_acc[j];
-            auto* out  = &new_acc[j];
-
-            auto* w_add = &ft_weights[m_features.added_1   * ACC_SIZE + j];
-            auto* w_rem = &ft_weights[m_features.removed_1 * ACC_SIZE + j];
-            auto* w_cap = &ft_weights[m_features.removed_2 * ACC_SIZE + j];
-
-            for (int i = 0; i < CHUNK_SIZE; i += INT16_PER_REG){
-                auto r = load_epi16(prev + i);
-
-                r = add_epi16(r, load_epi16(w_add + i));
-                r = sub_epi16(r, load_epi16(w_rem + i));
-                r = sub_epi16(r, load_epi16(w_cap + i));
-
-                store_epi16(out + i, r);
-            }
-        }
-        break;
-    case ModifiedFeatures::CASTLING:
-        for (int j = 0; j < ACC_SIZE; j += CHUNK_SIZE){
-            auto* prev = &prev_acc[j];
-            auto* out  = &new_acc[j];
-
-            auto* w_add  = &ft_weights[m_features.added_1   * ACC_SIZE + j];
-            auto* w_add2 = &ft_weights[m_features.added_2 * ACC_SIZE + j];
-            auto* w_rem  = &ft_weights[m_features.removed_1 * ACC_SIZE + j];
-            auto* w_cap  = &ft_weights[m_features.removed_2 * ACC_SIZE + j];
-
-            for (int i = 0; i < CHUNK_SIZE; i += INT16_PER_REG){
-
-                auto r = load_epi16(prev + i);
-
-                r = add_epi16(r, load_epi16(w_add  + i));
-                r = add_epi16(r, load_epi16(w_add2 + i));
-                r = sub_epi16(r, load_epi16(w_rem  + i));
-                r = sub_epi16(r, load_epi16(w_cap  + i));
-
-                store_epi16(out + i, r);
-            }
-        }
-        break;
-    }
+    kernels->update_accumulator(prev_acc, new_acc, m_features);
 }
 
 void update_accumulator(Accumulator& prev_acc, Accumulator& new_acc,
         const Features& added_features,
         const Features& removed_features){
-
-    vec_int16 registers[NUM_AVX_REGISTERS];
-    constexpr int CHUNK_SIZE = NUM_AVX_REGISTERS * INT16_PER_REG;
-
-    for (int j = 0; j < ACC_SIZE; j += CHUNK_SIZE){
-        for (int i = 0; i < NUM_AVX_REGISTERS; i++){
-            registers[i] = load_epi16(&prev_acc[j + i*INT16_PER_REG]); 
-        }
-
-        for (const int &a: added_features){
-            for (int i = 0; i < NUM_AVX_REGISTERS; i++){
-                // a*acc size is the index of the a-th row. We then accumulate the weights.
-                registers[i] = add_epi16(
-                    registers[i],
-                    load_epi16(&ft_weights[a*ACC_SIZE + j + i*INT16_PER_REG])
-                );
-            }
-        }
-
-        for (const int &r: removed_features){
-            for (int i = 0; i < NUM_AVX_REGISTERS; i++){
-                // r*acc size is the index of the r-th row. We then accumulate the weights.
-                registers[i] = sub_epi16(
-                    registers[i],
-                    load_epi16(&ft_weights[r*ACC_SIZE + j + i*INT16_PER_REG])
-                );
-            }
-        }
-
-        // store the result in the accumulator
-        for (int i = 0; i < NUM_AVX_REGISTERS; i++){
-            store_epi16(&new_acc[j + i*INT16_PER_REG], registers[i]);
-        }
-    }
+    kernels->update_accumulator_features(prev_acc, new_acc, added_features, removed_features);
 }
 
-// in the avx2 case:
-// non permuted weights (input_size=12, output_size=16):
-//
-// input size (12)
-// --------------->
-//   0   1   2   3    4   5   6   7    8   9  10  11 | output size (16)
-//  12  13  14  15   16  17  18  19   20  21  22  23 V
-//  24  25  26  27   28  29  30  31   32  33  34  35
-//  36  37  38  39   40  41  42  43   44  45  46  47
-//  48  49  50  51   52  53  54  55   56  57  58  59
-//  60  61  62  63   64  65  66  67   68  69  70  71
-//  72  73  74  75   76  77  78  79   80  81  82  83
-//  84  85  86  87   88  89  90  91   92  93  94  95  <- end of row_block 0 (rows 0-7)
-
-//  96  97  98  99  100 101 102 103  104 105 106 107
-// 108 109 110 111  112 113 114 115  116 117 118 119
-// 120 121 122 123  124 125 126 127  128 129 130 131
-// 132 133 134 135  136 137 138 139  140 141 142 143
-// 144 145 146 147  148 149 150 151  152 153 154 155
-// 156 157 158 159  160 161 162 163  164 165 166 167
-// 168 169 170 171  172 173 174 175  176 177 178 179
-// 180 181 182 183  184 185 186 187  188 189 190 191  <- end of row_block 1 (rows 8-15)
-//
-//
-// blocks are 8 rows x 4 cols
-// 3 col_blocks (12/4), 2 row_blocks (16/8)
-//
-//
-// blocks are flattened:
-// [0]  0  1  2  3  12 13 14 15  24 25 26 27  36 37 38 39  48 49 50 51  60 61 62 63  72 73 74 75  84 85 86 87
-// [1]  4  5  6  7  16 17 18 19  28 29 30 31  40 41 42 43  52 53 54 55  64 65 66 67  76 77 78 79  88 89 90 91
-// ...
-//
-// out:
-// acc 0:  [in[0..4] @ [0]] + [in[5..7] @ [1]] + [in[8..11] @ [2]]
-// acc 1:  [in[0..4] @ [3]] + [in[5..7] @ [4]] + [in[8..11] @ [5]]
-
-// thus:
-// // weight section:
-// [  ] ...
-// [  ] ...
-// [  ] ...
-// [  ] ...
-// ...
-// flattened: [  ][  ][  ][  ]...
-// height = out_size, width = 4
-
-// input:      1234|1234|1234|1234|1234|1234|1234|1234
-// weights:    [  ]|[  ]|[  ]|[  ]|[  ]|[  ]|[  ]|[  ]
-// maddubs:    * * |* * |* * |* * |* * |* * |* * |* *
-// madd:       x   |x   |x   |x   |x   |x   |x   |x   
-
-// -> accumulate for nnz chunks, and get output.
-
-void run_L1_sparse(uint8_t* input, int32_t* output, int bucket){
-
-    // 4 int8s at a time, as an int32.
-    constexpr int MAX_NNZ_INPUTS = L1_INPUT_SIZE / 4;
-    int16_t nnz_indices[MAX_NNZ_INPUTS]; // nonzero block indices
-    int num_nnz_inputs = 0;
-
-    __m128i offset = _mm_set1_epi16(0);
-    __m128i eight = _mm_set1_epi16(8);
-
-    // get nnz indices
-    for (int i = 0; i < L1_INPUT_SIZE; i += INT8_PER_REG){
-        vec_int32 input_chunk = load_epi32(reinterpret_cast<int32_t*>(&input[i]));
-        auto nnz_bitmask = nonzero_mask_epi32(input_chunk);
-
-        for (int group_idx = 0; group_idx < 8*sizeof(nnz_bitmask); group_idx += 8){
-            uint8_t group = (nnz_bitmask >> group_idx) & 0xFF;
-
-            __m128i indexes = _mm_loadu_si128((__m128i*)nnz_lookup[group]);
-            _mm_storeu_si128((__m128i*)(&nnz_indices[num_nnz_inputs]), _mm_add_epi16(offset, indexes));
-            num_nnz_inputs += std::popcount(group);
-            offset = _mm_add_epi16(offset, eight);
-        }
-    }
-
-    assert(num_nnz_inputs <= MAX_NNZ_INPUTS);
-    // std::cout << num_nnz_inputs << " ";
-
-    vec_int32 accs[L1_OUTPUT_SIZE / INT32_PER_REG] = {0};
-
-    for (int i = 0; i < num_nnz_inputs; i++){ 
-        // load the nonzero input group
-        int block_idx = nnz_indices[i]; // nonzero horizontal block index
-        vec_int8 input_group = set1_epi32(*reinterpret_cast<int32_t*>(&input[block_idx * 4])); // set1 as epi32 to load 4 int8s at a time
-        for (int j = 0; j < L1_OUTPUT_SIZE / INT32_PER_REG; j++) // vertical block idx
-            accs[j] = dpbusd_epi32(
-                accs[j],
-                input_group,
-                load_epi8(&l1_weights[
-                    bucket * L1_WEIGHTS_SIZE 
-                    + j * (L1_INPUT_SIZE / 4) * (INT32_PER_REG * 4)  // row stride
-                    + block_idx * (INT32_PER_REG * 4)                // col stride
-                ]
-            )
-        );
-    }
-
-    for (int k = 0; k < L1_OUTPUT_SIZE; k += INT32_PER_REG){
-        vec_int32 out = srai_epi32(
-            add_epi32(load_epi32(&l1_bias[bucket * L1_OUTPUT_SIZE + k]), accs[k / INT32_PER_REG]), 5
-        );
-        store_epi32(&output[k], out);
-    }
-};
-
-// int32_t run_L2(int16_t* input, int bucket){
-//     const vec_int16 zero = setzero_epi16();
-//     const vec_int16 qscale = set1_epi16(255);
-//     vec_int32 result = set1_epi32(0);
-
-//     for (int i = 0; i < L2_INPUT_SIZE; i += INT16_PER_REG){
-//         vec_int16 in = load_epi16(&input[i]);
-//         in = min_epi16(qscale, max_epi16(in, zero));
-
-//         vec_int16 weight_chunk = load_epi16(&l2_weights[bucket * L2_WEIGHTS_SIZE + i]);
-
-//         // madd pairs to int32 to avoid overflows in int16, while applying screlu
-//         vec_int32 prod = madd_epi16(in, mullo_epi16(in, weight_chunk));
-
-//         result = add_epi32(result, prod);
-//     }
-//     // result is (in*255) * (in*255) * (w*64) 
-
-//     return reduce1_epi32(result) / 255 + l2_bias[bucket];
-// };
-
-int32_t run_L2(int16_t* clamped_input, int32_t* input, int bucket){
-    int32_t result = 0;
+void update_accumulators(const Accumulator& base, Accumulator* const* outputs,
+        const ModifiedFeatures* const* updates, int count){
+    kernels->update_accumulators(base, outputs, updates, count);
+}
 
-    for (int i = 0; i < L1_OUTPUT_SIZE; i++){
-        int16_t c_in = std::clamp(clamped_input[i], (int16_t)0, (int16_t)255);
-        int32_t in = input[i];
+void pairwise_screlu16_to_8(int16_t* in, int16_t* in_pair, uint8_t* output, int size){
+    kernels->pairwise_screlu16_to_8(in, in_pair, output, size);
+}
 
-        result += c_in * l2_weights[bucket * L2_WEIGHTS_SIZE + i];
-        result += std::clamp(in * in, 0, 255*255) * l2_weights[bucket * L2_WEIGHTS_SIZE + L1_OUTPUT_SIZE + i] / 255;
-    }
+void run_L1_sparse(InferenceContext& ctx, int bucket){
+    kernels->run_L1_sparse(ctx, bucket);
+}
 
-    return result + l2_bias[bucket];
-};
+int32_t run_L2(int32_t* input, int bucket){
+    return kernels->run_L2(input, bucket);
+}
 
-int run(Accumulators& accumulators, Color stm, int piece_count, bool trace){
+int output_bucket(int piece_count){
     constexpr int pieces_per_bucket = 32 / NUM_OUTPUT_BUCKETS;
     int bucket = (piece_count - 2) / pieces_per_bucket;
 
-    if (trace)
-        std::cout << "Output bucket: " << bucket << std::endl;
-
     assert(bucket >= 0 && bucket < NUM_OUTPUT_BUCKETS);
+    return bucket;
+}
 
+int forward(Accumulators& accumulators, Color stm, int bucket, InferenceContext& ctx){
     pairwise_screlu16_to_8(
         &accumulators[stm][0],
         &accumulators[stm][ACC_SIZE / 2],
-        ft_clamped_output, ACC_SIZE / 2
+        ctx.ft_clamped_output, ACC_SIZE / 2
     );
 
     pairwise_screlu16_to_8(
         &accumulators[!stm][0],
         &accumulators[!stm][ACC_SIZE / 2],
-        &ft_clamped_output[ACC_SIZE / 2], ACC_SIZE / 2
+        &ctx.ft_clamped_output[ACC_SIZE / 2], ACC_SIZE / 2
     );
 
-    run_L1_sparse(ft_clamped_output, l1_output, bucket);
-
-    crelu32_to_16(l1_output, l1_clamped_output, L1_OUTPUT_SIZE);
+    run_L1_sparse(ctx, bucket);
 
-    int output = run_L2(l1_clamped_output, l1_output, bucket);
+    int output = run_L2(ctx.l1_output, bucket);
 
     return (output * 600) / (64 * 255); // scale is 600
+}
+
+int run(Accumulators& accumulators, Color stm, int piece_count, InferenceContext& ctx, bool trace){
+    int bucket = output_bucket(piece_count);
+
+    if (trace)
+        std::cout << "Output bucket: " << bucket << std::endl;
+
+    return forward(accumulators, stm, bucket, ctx);
 };
 
+void run_batch(Accumulators* accumulators, const Color* stm, const int* piece_counts, int* outputs, int count){
+    InferenceContext ctx;
+
+    // counting sort of the positions by output bucket
+    int bucket_start[NUM_OUTPUT_BUCKETS + 1] = {};
+    for (int i = 0; i < count; i++)
+        bucket_start[output_bucket(piece_counts[i]) + 1]++;
+
+    for (int bucket = 0; bucket < NUM_OUTPUT_BUCKETS; bucket++)
+        bucket_start[bucket + 1] += bucket_start[bucket];
+
+    std::vector<int> order(count);
+    int next[NUM_OUTPUT_BUCKETS];
+    std::copy(bucket_start, bucket_start + NUM_OUTPUT_BUCKETS, next);
+    for (int i = 0; i < count; i++)
+        order[next[output_bucket(piece_counts[i])]++] = i;
+
+    for (int bucket = 0; bucket < NUM_OUTPUT_BUCKETS; bucket++){
+        for (int k = bucket_start[bucket]; k < bucket_start[bucket + 1]; k++){
+            const int i = order[k];
+            outputs[i] = forward(accumulators[i], stm[i], bucket, ctx);
+        }
+    }
+}
+
 }; // namespace NNUE
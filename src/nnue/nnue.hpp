@@ -8,67 +8,11 @@
 #include <cstdint>
 #include <stdio.h>
 #include <chess.hpp>
-#include <immintrin.h>
 #include "constants.hpp"
-#include "nnue_misc.hpp"
+#include "nnue_kernels.hpp"
 
-using namespace NNUE_UTILS;
 using namespace chess;
 
-struct Features {
-    int size;
-    int features[32];
-
-    Features() = default;
-    Features(int size): size(size) {}
-
-    int* begin() { return features; }
-    int* end() { return features + size; }
-
-    const int* begin() const { return features; }
-    const int* end() const { return features + size; }
-
-    int& operator[](int index){
-        return features[index];
-    }
-};
-
-struct ModifiedFeatures {
-    int added_1 = -1;
-    int added_2 = -1;
-    int removed_1 = -1;
-    int removed_2 = -1;
-
-    enum {
-        NORMAL, CAPTURE, CASTLING
-    } type;
-
-    ModifiedFeatures() = default;
-
-    ModifiedFeatures(int added, int removed):
-        added_1(added),
-        removed_1(removed) {
-            type = NORMAL;
-        };
-
-    ModifiedFeatures(int added, int removed, int captured):
-        added_1(added),
-        removed_1(removed),
-        removed_2(captured) {
-            type = CAPTURE;
-        };
-
-    ModifiedFeatures(int added, int added_2, int removed, int removed_2):
-        added_1(added),
-        added_2(added_2),
-        removed_1(removed),
-        removed_2(removed_2) {
-            type = CASTLING;
-        };
-
-    bool valid() const;
-};
-
 namespace NNUE {
 
 inline int input_bucket(Square sq, Color color){
@@ -95,49 +39,44 @@ inline int feature(Color persp, Piece p, Square sq, Square king_sq){
          + (sq.index() ^ flip ^ mirror);
 }
 
-/*****************
-Feature transformer
-******************/
-
-// 2*input_size -> 2*acc_size 
-
-// weights are flattened 2d array, to be contiguous in memory.
-// weights are stored in row major
-extern int16_t* ft_weights;
-extern int16_t* ft_bias;
-
-/******
-Layer 1
-*******/
-
-// 2*acc_size -> 1
-
-extern int8_t* l1_weights;
-extern int32_t* l1_bias;
-
-void run_L1(int8_t* input, int32_t* output, int bucket);
-
-/******
-Layer 2
-*******/
-
-extern int16_t* l2_weights;
-extern int32_t* l2_bias;
-
-int32_t run_L2(int16_t* input, int bucket);
-
 void init();
 void cleanup();
 
+// kernels supported by the cpu, fastest first. init uses the first one.
+std::vector<const Kernels::Table*> supported_kernels();
+void set_kernels(const Kernels::Table& table);
+
+// name of the instruction set used by the simd kernels
+const char* kernels_name();
+
+// uses the network embedded in the executable
 void load_model();
 
-void compute_accumulator(Accumulator& new_acc, const Features active_features);
+// maps a network file written by utils/prepare_network.cpp, and uses it in place.
+// on failure, the current network is kept and error is set.
+bool load_network_file(const std::string& path, std::string& error);
+
+void compute_accumulator(Accumulator& new_acc, const Features& active_features);
 
 void update_accumulator(Accumulator& prev_acc, Accumulator& new_acc, const ModifiedFeatures& m_features);
 void update_accumulator(Accumulator& prev_acc, Accumulator& new_acc,
         const Features& added_features,
         const Features& removed_features);
 
-int run(Accumulators& accumulators, Color stm, int piece_count, bool trace = false);
+// applies count queued updates in a row, starting from base. each chunk of the accumulator
+// stays in registers across all the updates. outputs[k] receives the accumulator after
+// updates[k].
+void update_accumulators(const Accumulator& base, Accumulator* const* outputs,
+        const ModifiedFeatures* const* updates, int count);
+
+void pairwise_screlu16_to_8(int16_t* in, int16_t* in_pair, uint8_t* output, int size);
+void run_L1_sparse(InferenceContext& ctx, int bucket);
+int32_t run_L2(int32_t* input, int bucket);
+
+int run(Accumulators& accumulators, Color stm, int piece_count, InferenceContext& ctx, bool trace = false);
+
+// evaluates count positions. they are run grouped by output bucket, so that the layer 1 and
+// layer 2 weights of a bucket stay in cache for the whole group. outputs are in input order.
+void run_batch(Accumulators* accumulators, const Color* stm, const int* piece_counts, int* outputs, int count);
 
 }; // namespace NNUE
\ No newline at end of file
@@ -23,6 +23,7 @@ AllBitboards::AllBitboards(const NnueBoard& pos) {
 
 NnueBoard::NnueBoard(){
     accumulators_stack.push_empty();
+    reset_finny_table();
     synchronize();
 };
 
@@ -36,7 +37,9 @@ void NnueBoard::synchronize(){
     recompute_pawn_key();
     recompute_minor_major_keys();
     recompute_nonpawn_keys();
+}
 
+void NnueBoard::reset_finny_table(){
     AllBitboards empty_pos = AllBitboards(); // empty position;
     Accumulator empty_acc;
     NNUE::compute_accumulator(empty_acc, {}); // accumulators for an empty position;
@@ -44,6 +47,21 @@ void NnueBoard::synchronize(){
         for (int color = 0; color < 2; color++)
             for (int mirrored = 0; mirrored < 2; mirrored++)
                 finny_table[bucket][color][mirrored] = std::make_pair(empty_pos, empty_acc);
+
+    std::fill(eval_cache.begin(), eval_cache.end(), EvalCacheEntry());
+}
+
+void NnueBoard::set_eval_cache(bool enabled){
+    eval_cache = std::vector<EvalCacheEntry>(enabled ? EVAL_CACHE_SIZE : 0);
+}
+
+bool NnueBoard::eval_cache_enabled() const {
+    return !eval_cache.empty();
+}
+
+void NnueBoard::set_position(const NnueBoard& other){
+    static_cast<Board&>(*this) = other;
+    accumulators_stack = other.accumulators_stack;
 }
 
 bool NnueBoard::legal(Move move){
@@ -82,6 +100,8 @@ void NnueBoard::update_state(Move move, TranspositionTable& tt){
         auto modified = get_modified_features(stm, prev_pos, *this);
 
         NNUE::update_accumulator(prev_acc, new_accs[stm], modified.first, modified.second);
+        num_refreshes++;
+        num_refreshed_features += modified.first.size + modified.second.size;
         accumulators_stack.clear_top_update(stm);
 
         finny_table[bucket][stm][mirrored] = std::make_pair(
@@ -95,7 +115,7 @@ void NnueBoard::update_state(Move move, TranspositionTable& tt){
         makeMove(move);
     }
 
-    __builtin_prefetch(&tt.entries[hash() & (tt.size - 1)]);
+    tt.prefetch(hash());
 }
 
 void NnueBoard::restore_state(Move move){
@@ -105,21 +125,49 @@ void NnueBoard::restore_state(Move move){
     accumulators_stack.pop();
 }
 
-int NnueBoard::evaluate(bool trace){
+// the network output only depends on the position, so it can be cached by zobrist key.
+// on a hit the pending accumulator updates are left queued.
+int NnueBoard::nnue_output(bool trace){
+    if (trace || eval_cache.empty()){
+        accumulators_stack.apply_lazy_updates();
+        return NNUE::run(accumulators_stack.top(), sideToMove(), occ().count(), inference_ctx, trace);
+    }
+
+    EvalCacheEntry& entry = eval_cache[hash() & (EVAL_CACHE_SIZE - 1)];
+    if (entry.key == hash()){
+        eval_cache_hits++;
+        return entry.nnue;
+    }
+    eval_cache_misses++;
+
     accumulators_stack.apply_lazy_updates();
 
-    const int nnue = NNUE::run(accumulators_stack.top(), sideToMove(), occ().count(), trace);
-    const int material_scale = mat_base
-        + k_scale * pieces(PieceType::KNIGHT).count() 
-        + b_scale * pieces(PieceType::BISHOP).count()
-        + r_scale * pieces(PieceType::ROOK).count()
-        + q_scale * pieces(PieceType::QUEEN).count();
+    entry.key = hash();
+    entry.nnue = NNUE::run(accumulators_stack.top(), sideToMove(), occ().count(), inference_ctx, trace);
+    return entry.nnue;
+}
+
+int NnueBoard::evaluate(bool trace){
+    const int nnue = nnue_output(trace);
+    const int scale = material_scale();
 
     if (trace){
         std::cout << "NNUE output: " << nnue << std::endl;
-        std::cout << "Material scale: " << material_scale << std::endl;
+        std::cout << "Material scale: " << scale << std::endl;
     }
 
+    return scale_evaluation(nnue, scale);
+}
+
+int NnueBoard::material_scale(){
+    return mat_base
+        + k_scale * pieces(PieceType::KNIGHT).count() 
+        + b_scale * pieces(PieceType::BISHOP).count()
+        + r_scale * pieces(PieceType::ROOK).count()
+        + q_scale * pieces(PieceType::QUEEN).count();
+}
+
+int NnueBoard::scale_evaluation(int nnue, int material_scale){
     return std::clamp(nnue * material_scale / 16384, -BEST_VALUE, BEST_VALUE);
 }
 
@@ -129,6 +177,46 @@ bool NnueBoard::is_stalemate(){
     return movelist.empty();
 }
 
+bool NnueBoard::upcoming_repetition(int ply){
+    const int size = prev_states_.size();
+    const int end = std::min<int>(hfm_, size);
+    if (end < 3)
+        return false;
+
+    // positions with the same side to move are 2 plies apart, other holds the zobrist
+    // difference made by the opponent's moves since then. only when it is zero can a single
+    // move of the side to move return to that position.
+    const uint64_t key = hash();
+    uint64_t other = key ^ prev_states_[size - 1].hash ^ Zobrist::sideToMove();
+
+    for (int i = 3; i <= end; i += 2){
+        const int idx = size - i;
+        other ^= prev_states_[idx + 1].hash ^ prev_states_[idx].hash ^ Zobrist::sideToMove();
+        if (other != 0)
+            continue;
+
+        const Cuckoo::Entry* entry = Cuckoo::probe(key ^ prev_states_[idx].hash);
+        if (entry == nullptr || (entry->between & occ()))
+            continue;
+
+        // the entry holds both directions of the move, find the square of our piece
+        const Square from = at(entry->move.from()) == Piece::NONE ? entry->move.to() : entry->move.from();
+        if (at(from).color() != sideToMove())
+            continue;
+
+        if (ply > i)
+            return true;
+
+        // the position is at or before the root, so it has to be a repetition itself
+        for (int j = idx - 2; j >= 0 && j >= idx - prev_states_[idx].half_moves; j -= 2){
+            if (prev_states_[j].hash == prev_states_[idx].hash)
+                return true;
+        }
+    }
+
+    return false;
+}
+
 std::pair<Features, Features> NnueBoard::get_features(){
     Bitboard occupied = occ();
 
@@ -303,34 +391,38 @@ void NnueBoard::AccumulatorsStack::pop(){
 }
 
 void NnueBoard::AccumulatorsStack::apply_lazy_updates(){
-    int i_w = idx;
-    int i_b = idx;
-    while (queued_updates[i_w][(int)Color::WHITE].valid())
-        i_w--;
-
-    while (queued_updates[i_b][(int)Color::BLACK].valid())
-        i_b--;
-
-    int i = std::min(i_w, i_b);
-
-    for (; i < idx; i++){
-        Accumulators& prev_accs = stack[i];
-        Accumulators& new_accs = stack[i + 1];
-
-        // prefetch weight rows for black while processing white
-        __builtin_prefetch(&NNUE::ft_weights[queued_updates[i + 1][1].added_1 * ACC_SIZE]);
-        __builtin_prefetch(&NNUE::ft_weights[queued_updates[i + 1][1].removed_1 * ACC_SIZE]);
-
-        // white
-        if (i >= i_w){
-            NNUE::update_accumulator(prev_accs[0], new_accs[0], queued_updates[i + 1][0]);
-            queued_updates[i + 1][0] = ModifiedFeatures();
+    // prefetch weight rows for black while processing white
+    __builtin_prefetch(&NNUE::ft_weights[queued_updates[idx][1].added_1 * ACC_SIZE]);
+    __builtin_prefetch(&NNUE::ft_weights[queued_updates[idx][1].removed_1 * ACC_SIZE]);
+
+    for (Color color: {Color::WHITE, Color::BLACK}){
+        int i = idx;
+        while (queued_updates[i][color].valid())
+            i--;
+
+        const int count = idx - i;
+        if (count == 0)
+            continue;
+
+        if (count == 1){
+            NNUE::update_accumulator(stack[i][color], stack[idx][color], queued_updates[idx][color]);
+            queued_updates[idx][color] = ModifiedFeatures();
+            continue;
         }
 
-        // black
-        if (i >= i_b){
-            NNUE::update_accumulator(prev_accs[1], new_accs[1], queued_updates[i + 1][1]);
-            queued_updates[i + 1][1] = ModifiedFeatures();
+        // several plies are pending: apply them in a single pass, so the intermediate
+        // accumulators are stored but never reloaded. they are all written, as each one
+        // is the starting point of its siblings.
+        Accumulator* outputs[MAX_PLY + 1];
+        const ModifiedFeatures* updates[MAX_PLY + 1];
+        for (int k = 0; k < count; k++){
+            outputs[k] = &stack[i + 1 + k][color];
+            updates[k] = &queued_updates[i + 1 + k][color];
         }
+
+        NNUE::update_accumulators(stack[i][color], outputs, updates, count);
+
+        for (int k = i + 1; k <= idx; k++)
+            queued_updates[k][color] = ModifiedFeatures();
     }
-}
\ No newline at end of file
+}
@@ -10,6 +10,7 @@
 #include "misc.hpp"
 #include "constants.hpp"
 #include "tune.hpp"
+#include "cuckoo.hpp"
 
 using BothModifiedFeatures = std::array<ModifiedFeatures, 2>;
 
@@ -23,13 +24,33 @@ class AllBitboards {
     AllBitboards(const NnueBoard& pos);
 };
 
-class NnueBoard: public Board {
+class NnueBoard final: public Board {
     public:
 
     NnueBoard();
 
+    // recomputes the accumulators of the current position. the refresh table is kept,
+    // as its entries stay valid for any position.
     void synchronize();
 
+    // empties the refresh table and the eval cache, needed when the network changes.
+    void reset_finny_table();
+
+    // copies the position of other, but keeps the refresh table of this board.
+    void set_position(const NnueBoard& other);
+
+    // refresh statistics, reported by bench
+    int64_t num_refreshes = 0;
+    int64_t num_refreshed_features = 0;
+
+    // eval cache statistics, reported by bench
+    int64_t eval_cache_hits = 0;
+    int64_t eval_cache_misses = 0;
+
+    // the eval cache is off by default, as it has not shown a measurable speedup
+    void set_eval_cache(bool enabled);
+    bool eval_cache_enabled() const;
+
     bool legal(Move move);
 
     void update_state(Move move, TranspositionTable& tt);
@@ -38,8 +59,16 @@ class NnueBoard: public Board {
 
     int evaluate(bool trace = false);
 
+    // the evaluation is the network output scaled by the material left on the board
+    int material_scale();
+    static int scale_evaluation(int nnue, int material_scale);
+
     bool is_stalemate();
 
+    // whether the side to move has a move to a position seen since the last irreversible move.
+    // ply is the distance to the root: positions before the root only count if they occurred twice.
+    bool upcoming_repetition(int ply);
+
     std::pair<Features, Features> get_features();
     Features get_features(Color persp);
 
@@ -66,6 +95,19 @@ class NnueBoard: public Board {
 
     private:
 
+    NNUE::InferenceContext inference_ctx;
+
+    // raw network outputs of recently evaluated positions, indexed by the low bits of the zobrist key.
+    struct EvalCacheEntry {
+        uint64_t key = 0;
+        int32_t nnue = 0;
+    };
+
+    static constexpr int EVAL_CACHE_SIZE = 1 << 14;
+    std::vector<EvalCacheEntry> eval_cache; // empty when disabled
+
+    int nnue_output(bool trace);
+
     // accessed by [bucket][stm][mirrored]
     std::array<std::array<std::array<std::pair<AllBitboards, Accumulator>, 2>, 2>, NUM_INPUT_BUCKETS> finny_table;
 
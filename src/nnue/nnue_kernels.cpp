@@ -0,0 +1,337 @@
+#include <bit>
+#include "nnue_kernels.hpp"
+#include "nnue_misc.hpp"
+
+// this file is compiled once per instruction set (see CMakeLists.txt), and simd.hpp
+// puts each build in its own namespace. NNUE::init picks one at startup.
+
+using namespace NNUE_UTILS;
+
+namespace NNUE::Kernels::SIMD_NAMESPACE {
+
+void compute_accumulator(Accumulator& new_acc, const Features& active_features){
+    for (int i = 0; i < ACC_SIZE; i += INT16_PER_REG){
+        auto r = load_epi16(&ft_bias[i]);
+
+        for (const int &a: active_features)
+            r = add_epi16(r, load_epi16(&ft_weights[a * ACC_SIZE + i]));
+
+        store_epi16(&new_acc[i], r);
+    }
+};
+
+void update_accumulator(Accumulator& prev_acc, Accumulator& new_acc, const ModifiedFeatures& m_features){
+    assert(m_features.valid());
+    constexpr int CHUNK_SIZE = NUM_AVX_REGISTERS * INT16_PER_REG;
+
+    switch (m_features.type)
+    {
+    case ModifiedFeatures::NORMAL:
+    {
+        auto* prev = &prev_acc[0];
+        auto* out  = &new_acc[0];
+        auto* w_add = &ft_weights[m_features.added_1 * ACC_SIZE];
+        auto* w_rem = &ft_weights[m_features.removed_1 * ACC_SIZE];
+
+        for (int i = 0; i < ACC_SIZE; i += INT16_PER_REG * 4){ // process 4 registers at once
+            
+            auto r1 = load_epi16(prev + i);
+            auto r2 = load_epi16(prev + i + INT16_PER_REG);
+            auto r3 = load_epi16(prev + i + INT16_PER_REG*2);
+            auto r4 = load_epi16(prev + i + INT16_PER_REG*3);
+
+            r1 = add_epi16(r1, load_epi16(w_add + i));
+            r2 = add_epi16(r2, load_epi16(w_add + i + INT16_PER_REG));
+            r3 = add_epi16(r3, load_epi16(w_add + i + INT16_PER_REG*2));
+            r4 = add_epi16(r4, load_epi16(w_add + i + INT16_PER_REG*3));
+
+            r1 = sub_epi16(r1, load_epi16(w_rem + i));
+            r2 = sub_epi16(r2, load_epi16(w_rem + i + INT16_PER_REG));
+            r3 = sub_epi16(r3, load_epi16(w_rem + i + INT16_PER_REG*2));
+            r4 = sub_epi16(r4, load_epi16(w_rem + i + INT16_PER_REG*3));
+
+            store_epi16(out + i, r1);
+            store_epi16(out + i + INT16_PER_REG, r2);
+            store_epi16(out + i + INT16_PER_REG*2, r3);
+            store_epi16(out + i + INT16_PER_REG*3, r4);
+        }
+        break;
+    }
+    case ModifiedFeatures::CAPTURE:
+        for (int j = 0; j < ACC_SIZE; j += CHUNK_SIZE){
+            auto* prev = &prev_acc[j];
+            auto* out  = &new_acc[j];
+
+            auto* w_add = &ft_weights[m_features.added_1   * ACC_SIZE + j];
+            auto* w_rem = &ft_weights[m_features.removed_1 * ACC_SIZE + j];
+            auto* w_cap = &ft_weights[m_features.removed_2 * ACC_SIZE + j];
+
+            for (int i = 0; i < CHUNK_SIZE; i += INT16_PER_REG){
+                auto r = load_epi16(prev + i);
+
+                r = add_epi16(r, load_epi16(w_add + i));
+                r = sub_epi16(r, load_epi16(w_rem + i));
+                r = sub_epi16(r, load_epi16(w_cap + i));
+
+                store_epi16(out + i, r);
+            }
+        }
+        break;
+    case ModifiedFeatures::CASTLING:
+        for (int j = 0; j < ACC_SIZE; j += CHUNK_SIZE){
+            auto* prev = &prev_acc[j];
+            auto* out  = &new_acc[j];
+
+            auto* w_add  = &ft_weights[m_features.added_1   * ACC_SIZE + j];
+            auto* w_add2 = &ft_weights[m_features.added_2 * ACC_SIZE + j];
+            auto* w_rem  = &ft_weights[m_features.removed_1 * ACC_SIZE + j];
+            auto* w_cap  = &ft_weights[m_features.removed_2 * ACC_SIZE + j];
+
+            for (int i = 0; i < CHUNK_SIZE; i += INT16_PER_REG){
+
+                auto r = load_epi16(prev + i);
+
+                r = add_epi16(r, load_epi16(w_add  + i));
+                r = add_epi16(r, load_epi16(w_add2 + i));
+                r = sub_epi16(r, load_epi16(w_rem  + i));
+                r = sub_epi16(r, load_epi16(w_cap  + i));
+
+                store_epi16(out + i, r);
+            }
+        }
+        break;
+    }
+}
+
+void update_accumulator_features(Accumulator& prev_acc, Accumulator& new_acc,
+        const Features& added_features,
+        const Features& removed_features){
+
+    vec_int16 registers[NUM_AVX_REGISTERS];
+    constexpr int CHUNK_SIZE = NUM_AVX_REGISTERS * INT16_PER_REG;
+
+    for (int j = 0; j < ACC_SIZE; j += CHUNK_SIZE){
+        for (int i = 0; i < NUM_AVX_REGISTERS; i++){
+            registers[i] = load_epi16(&prev_acc[j + i*INT16_PER_REG]); 
+        }
+
+        for (const int &a: added_features){
+            for (int i = 0; i < NUM_AVX_REGISTERS; i++){
+                // a*acc size is the index of the a-th row. We then accumulate the weights.
+                registers[i] = add_epi16(
+                    registers[i],
+                    load_epi16(&ft_weights[a*ACC_SIZE + j + i*INT16_PER_REG])
+                );
+            }
+        }
+
+        for (const int &r: removed_features){
+            for (int i = 0; i < NUM_AVX_REGISTERS; i++){
+                // r*acc size is the index of the r-th row. We then accumulate the weights.
+                registers[i] = sub_epi16(
+                    registers[i],
+                    load_epi16(&ft_weights[r*ACC_SIZE + j + i*INT16_PER_REG])
+                );
+            }
+        }
+
+        // store the result in the accumulator
+        for (int i = 0; i < NUM_AVX_REGISTERS; i++){
+            store_epi16(&new_acc[j + i*INT16_PER_REG], registers[i]);
+        }
+    }
+}
+
+void update_accumulators(const Accumulator& base, Accumulator* const* outputs,
+        const ModifiedFeatures* const* updates, int count){
+
+    vec_int16 registers[NUM_AVX_REGISTERS];
+    constexpr int CHUNK_SIZE = NUM_AVX_REGISTERS * INT16_PER_REG;
+
+    for (int j = 0; j < ACC_SIZE; j += CHUNK_SIZE){
+        for (int i = 0; i < NUM_AVX_REGISTERS; i++)
+            registers[i] = load_epi16(&base[j + i*INT16_PER_REG]);
+
+        for (int k = 0; k < count; k++){
+            const ModifiedFeatures& m_features = *updates[k];
+            assert(m_features.valid());
+
+            auto* w_add = &ft_weights[m_features.added_1 * ACC_SIZE + j];
+            auto* w_rem = &ft_weights[m_features.removed_1 * ACC_SIZE + j];
+
+            for (int i = 0; i < NUM_AVX_REGISTERS; i++){
+                registers[i] = add_epi16(registers[i], load_epi16(w_add + i*INT16_PER_REG));
+                registers[i] = sub_epi16(registers[i], load_epi16(w_rem + i*INT16_PER_REG));
+            }
+
+            if (m_features.type != ModifiedFeatures::NORMAL){
+                auto* w_cap = &ft_weights[m_features.removed_2 * ACC_SIZE + j];
+                for (int i = 0; i < NUM_AVX_REGISTERS; i++)
+                    registers[i] = sub_epi16(registers[i], load_epi16(w_cap + i*INT16_PER_REG));
+            }
+
+            if (m_features.type == ModifiedFeatures::CASTLING){
+                auto* w_add2 = &ft_weights[m_features.added_2 * ACC_SIZE + j];
+                for (int i = 0; i < NUM_AVX_REGISTERS; i++)
+                    registers[i] = add_epi16(registers[i], load_epi16(w_add2 + i*INT16_PER_REG));
+            }
+
+            for (int i = 0; i < NUM_AVX_REGISTERS; i++)
+                store_epi16(&(*outputs[k])[j + i*INT16_PER_REG], registers[i]);
+        }
+    }
+}
+
+// non permuted weights (input_size=12, output_size=16):
+//
+// input size (12)
+// --------------->
+//   0   1   2   3    4   5   6   7    8   9  10  11 | output size (16)
+//  12  13  14  15   16  17  18  19   20  21  22  23 V
+//  24  25  26  27   28  29  30  31   32  33  34  35
+//  ...
+// 180 181 182 183  184 185 186 187  188 189 190 191
+//
+//
+// blocks are 16 rows x 4 cols, one block per col_block (12/4 = 3).
+// a block spans every output, so the layout does not depend on the register width:
+// a register of INT32_PER_REG rows reads the consecutive bytes of rows j*INT32_PER_REG onwards.
+//
+//
+// blocks are flattened:
+// [0]  0  1  2  3  12 13 14 15  24 25 26 27  ...  180 181 182 183
+// [1]  4  5  6  7  16 17 18 19  28 29 30 31  ...  184 185 186 187
+// ...
+//
+// out (avx2, 8 rows per register):
+// acc 0:  [in[0..3] @ [0] rows 0-7]  + [in[4..7] @ [1] rows 0-7]  + [in[8..11] @ [2] rows 0-7]
+// acc 1:  [in[0..3] @ [0] rows 8-15] + [in[4..7] @ [1] rows 8-15] + [in[8..11] @ [2] rows 8-15]
+
+// input:      1234|1234|1234|1234|1234|1234|1234|1234
+// weights:    [  ]|[  ]|[  ]|[  ]|[  ]|[  ]|[  ]|[  ]
+// maddubs:    * * |* * |* * |* * |* * |* * |* * |* *
+// madd:       x   |x   |x   |x   |x   |x   |x   |x   
+
+// -> accumulate for nnz chunks, and get output.
+
+void run_L1_sparse(InferenceContext& ctx, int bucket){
+    uint8_t* input = ctx.ft_clamped_output;
+    int32_t* output = ctx.l1_output;
+
+    // 4 int8s at a time, as an int32.
+    constexpr int MAX_NNZ_INPUTS = L1_INPUT_SIZE / 4;
+    int16_t nnz_indices[MAX_NNZ_INPUTS]; // nonzero block indices
+    int num_nnz_inputs = 0;
+
+    __m128i offset = _mm_set1_epi16(0);
+    __m128i eight = _mm_set1_epi16(8);
+
+    // masks are read 8 bits at a time, so with sse the masks of 2 registers are combined.
+    constexpr int REGS_PER_MASK = INT32_PER_REG >= 8 ? 1 : 8 / INT32_PER_REG;
+
+    // get nnz indices
+    for (int i = 0; i < L1_INPUT_SIZE; i += REGS_PER_MASK * INT8_PER_REG){
+        uint32_t nnz_bitmask = 0;
+        for (int r = 0; r < REGS_PER_MASK; r++){
+            vec_int32 input_chunk = load_epi32(reinterpret_cast<int32_t*>(&input[i + r * INT8_PER_REG]));
+            nnz_bitmask |= uint32_t(nonzero_mask_epi32(input_chunk)) << (r * INT32_PER_REG);
+        }
+
+        for (int group_idx = 0; group_idx < REGS_PER_MASK * INT32_PER_REG; group_idx += 8){
+            uint8_t group = (nnz_bitmask >> group_idx) & 0xFF;
+
+            __m128i indexes = _mm_loadu_si128((__m128i*)nnz_lookup[group]);
+            _mm_storeu_si128((__m128i*)(&nnz_indices[num_nnz_inputs]), _mm_add_epi16(offset, indexes));
+            num_nnz_inputs += std::popcount(group);
+            offset = _mm_add_epi16(offset, eight);
+        }
+    }
+
+    assert(num_nnz_inputs <= MAX_NNZ_INPUTS);
+    // std::cout << num_nnz_inputs << " ";
+
+    constexpr int NUM_REGS = L1_OUTPUT_SIZE / INT32_PER_REG;
+
+    // dpbusd takes several cycles, so a single sum would wait on every previous input.
+    // the nonzero inputs are spread over independent sums, added together at the end.
+    constexpr int NUM_SUMS = 4;
+    vec_int32 accs[NUM_SUMS][NUM_REGS];
+    for (int s = 0; s < NUM_SUMS; s++)
+        for (int j = 0; j < NUM_REGS; j++)
+            accs[s][j] = setzero_epi32();
+
+    const int8_t* weights = &l1_weights[bucket * L1_WEIGHTS_SIZE];
+
+    auto accumulate = [&](vec_int32* acc, int block_idx){ // nonzero horizontal block index
+        // set1 as epi32 to load 4 int8s at a time
+        vec_int8 input_group = set1_epi32(*reinterpret_cast<int32_t*>(&input[block_idx * 4]));
+        for (int j = 0; j < NUM_REGS; j++) // register idx
+            acc[j] = dpbusd_epi32(
+                acc[j],
+                input_group,
+                load_epi8(&weights[
+                    block_idx * (L1_OUTPUT_SIZE * 4)  // col stride
+                    + j * INT8_PER_REG                // rows within the block
+                ])
+            );
+    };
+
+    int i = 0;
+    for (; i + NUM_SUMS <= num_nnz_inputs; i += NUM_SUMS)
+        for (int s = 0; s < NUM_SUMS; s++)
+            accumulate(accs[s], nnz_indices[i + s]);
+
+    for (; i < num_nnz_inputs; i++)
+        accumulate(accs[0], nnz_indices[i]);
+
+    for (int s = 1; s < NUM_SUMS; s++)
+        for (int j = 0; j < NUM_REGS; j++)
+            accs[0][j] = add_epi32(accs[0][j], accs[s][j]);
+
+    for (int k = 0; k < L1_OUTPUT_SIZE; k += INT32_PER_REG){
+        vec_int32 out = srai_epi32(
+            add_epi32(load_epi32(&l1_bias[bucket * L1_OUTPUT_SIZE + k]), accs[0][k / INT32_PER_REG]), 5
+        );
+        store_epi32(&output[k], out);
+    }
+};
+
+// dual activation: the first half of the weights applies to crelu(in),
+// and the second half to clamp(in * in, 0, 255 * 255) / 255.
+int32_t run_L2(int32_t* input, int bucket){
+    const vec_int32 zero = setzero_epi32();
+    const vec_int32 qscale = set1_epi32(255);
+    const vec_int32 neg_qscale = set1_epi32(-255);
+    const int16_t* weights = &l2_weights[bucket * L2_WEIGHTS_SIZE];
+
+    vec_int32 result = setzero_epi32();
+
+    for (int i = 0; i < L1_OUTPUT_SIZE; i += INT32_PER_REG){
+        vec_int32 in = load_epi32(&input[i]);
+
+        vec_int32 c_in = min_epi32(qscale, max_epi32(in, zero));
+        result = add_epi32(result, mullo_epi32(c_in, load_epi16_to_epi32(&weights[i])));
+
+        // clamping to [-255, 255] before squaring gives the same result as clamping the square,
+        // and cannot overflow.
+        vec_int32 s_in = min_epi32(qscale, max_epi32(in, neg_qscale));
+        vec_int32 sq_in = mullo_epi32(s_in, s_in);
+        vec_int32 prod = mullo_epi32(sq_in, load_epi16_to_epi32(&weights[L1_OUTPUT_SIZE + i]));
+        result = add_epi32(result, div255_epi32(prod)); // each product is rounded separately
+    }
+
+    return reduce1_epi32(result) + l2_bias[bucket];
+};
+
+const Table table = {
+    SIMD_NAME,
+    compute_accumulator,
+    update_accumulator,
+    update_accumulator_features,
+    update_accumulators,
+    NNUE_UTILS::pairwise_screlu16_to_8,
+    run_L1_sparse,
+    run_L2,
+};
+
+}; // namespace NNUE::Kernels::SIMD_NAMESPACE
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include "constants.hpp"
+
+// declarations shared with nnue_kernels.cpp, which is compiled once per instruction set.
+// this header must not include chess.hpp, so that the inline functions of the engine are
+// never compiled with instructions the cpu may not support.
+
+struct Features {
+    int size;
+    int features[32];
+
+    Features() = default;
+    Features(int size): size(size) {}
+
+    int* begin() { return features; }
+    int* end() { return features + size; }
+
+    const int* begin() const { return features; }
+    const int* end() const { return features + size; }
+
+    int& operator[](int index){
+        return features[index];
+    }
+};
+
+struct ModifiedFeatures {
+    int added_1 = -1;
+    int added_2 = -1;
+    int removed_1 = -1;
+    int removed_2 = -1;
+
+    enum {
+        NORMAL, CAPTURE, CASTLING
+    } type;
+
+    ModifiedFeatures() = default;
+
+    ModifiedFeatures(int added, int removed):
+        added_1(added),
+        removed_1(removed) {
+            type = NORMAL;
+        };
+
+    ModifiedFeatures(int added, int removed, int captured):
+        added_1(added),
+        removed_1(removed),
+        removed_2(captured) {
+            type = CAPTURE;
+        };
+
+    ModifiedFeatures(int added, int added_2, int removed, int removed_2):
+        added_1(added),
+        added_2(added_2),
+        removed_1(removed),
+        removed_2(removed_2) {
+            type = CASTLING;
+        };
+
+    bool valid() const;
+};
+
+namespace NNUE {
+
+// scratch buffers written during inference. Each board owns one,
+// so that search threads never share them.
+struct alignas(64) InferenceContext {
+    alignas(64) uint8_t ft_clamped_output[L1_INPUT_SIZE];
+
+    alignas(64) int32_t l1_output[L1_OUTPUT_SIZE];
+};
+
+/*****************
+Feature transformer
+******************/
+
+// 2*input_size -> 2*acc_size 
+
+// weights are flattened 2d array, to be contiguous in memory.
+// weights are stored in row major
+extern const int16_t* ft_weights;
+extern const int16_t* ft_bias;
+
+/******
+Layer 1
+*******/
+
+// 2*acc_size -> 1
+
+extern const int8_t* l1_weights;
+extern const int32_t* l1_bias;
+
+/******
+Layer 2
+*******/
+
+extern const int16_t* l2_weights;
+extern const int32_t* l2_bias;
+
+// indices of the set bits of each byte, used to find the nonzero inputs of layer 1
+extern int16_t nnz_lookup[256][8];
+
+namespace Kernels {
+
+// the simd functions of the network, for one instruction set.
+struct Table {
+    const char* name;
+
+    void (*compute_accumulator)(Accumulator& new_acc, const Features& active_features);
+    void (*update_accumulator)(Accumulator& prev_acc, Accumulator& new_acc, const ModifiedFeatures& m_features);
+    void (*update_accumulator_features)(Accumulator& prev_acc, Accumulator& new_acc,
+            const Features& added_features, const Features& removed_features);
+    void (*update_accumulators)(const Accumulator& base, Accumulator* const* outputs,
+            const ModifiedFeatures* const* updates, int count);
+
+    void (*pairwise_screlu16_to_8)(int16_t* in, int16_t* in_pair, uint8_t* output, int size);
+    void (*run_L1_sparse)(InferenceContext& ctx, int bucket);
+    int32_t (*run_L2)(int32_t* input, int bucket);
+};
+
+// one table per build of nnue_kernels.cpp, the namespaces are set in simd.hpp
+namespace sse41 { extern const Table table; }
+namespace avx2 { extern const Table table; }
+namespace avx2_vnni { extern const Table table; }
+namespace avx512_vnni { extern const Table table; }
+
+}; // namespace Kernels
+
+}; // namespace NNUE
@@ -2,11 +2,13 @@
 
 #include <cstdint>
 #include <cmath>
-#include <chess.hpp>
+#include <cassert>
 #include "simd.hpp"
 
 namespace NNUE_UTILS {
 
+inline namespace SIMD_NAMESPACE {
+
 [[maybe_unused]]
 inline void crelu16_to_16(int16_t *input, int16_t *output, int size){ // clamp(0, 255)
 
@@ -22,6 +24,21 @@ inline void crelu16_to_16(int16_t *input, int16_t *output, int size){ // clamp(0
     }
 }
 
+// truncating division of int32s by 255, exact for any input:
+// |x| * ceil(2^39 / 255) >> 39. mul_epu32 only uses the low half of each 64 bit lane,
+// so even and odd lanes are computed separately.
+inline vec_int32 div255_epi32(vec_int32 x){
+    const vec_int32 magic = set1_epi32(0x80808081);
+    const vec_int32 sign = srai_epi32(x, 31);
+    const vec_int32 abs_x = abs_epi32(x);
+
+    vec_int32 even = srli_epi64(mul_epu32(abs_x, magic), 39);
+    vec_int32 odd = slli_epi64(srli_epi64(mul_epu32(srli_epi64(abs_x, 32), magic), 39), 32);
+
+    vec_int32 quotient = or_si(even, odd);
+    return sub_epi32(xor_si(quotient, sign), sign); // restore the sign
+}
+
 #ifdef USE_AVX2 // these functions use the AVX2 specific instructions permute4x64_epi64, hadd_epi32 and permute2x128_si256
     [[maybe_unused]]
     inline void crelu32_to_8_127(int32_t *input, int8_t *output, int size){ // clamp(0, 127)
@@ -229,4 +246,39 @@ inline void crelu16_to_16(int16_t *input, int16_t *output, int size){ // clamp(0
     }
 #endif
 
-}; // namespace NNUE_UTILS
\ No newline at end of file
+#ifdef USE_SSE41
+    [[maybe_unused]]
+    inline void pairwise_screlu16_to_8(int16_t *in, int16_t *in_pair, uint8_t *output, int size){ // clamp(in1, 0, 255) * clamp(in2, 0, 255) / 512
+
+        assert(size % (2*INT16_PER_REG) == 0);
+
+        const vec_int16 zero = setzero_epi16();
+        const vec_int16 qscale  = set1_epi16(255);
+
+        for (int i = 0; i < size; i += 2*INT16_PER_REG){
+            vec_int16 in_1 = load_epi16(&in[i]);
+            vec_int16 in_1_pair = load_epi16(&in_pair[i]);
+        
+            vec_int16 in_2 = load_epi16(&in[i + INT16_PER_REG]);
+            vec_int16 in_2_pair = load_epi16(&in_pair[i + INT16_PER_REG]);
+
+            in_1 = min_epi16(qscale, max_epi16(in_1, zero));
+            in_1_pair = min_epi16(qscale, in_1_pair); // max is unnecessary as packus will clamp values
+
+            in_2 = min_epi16(qscale, max_epi16(in_2, zero));
+            in_2_pair = min_epi16(qscale, in_2_pair);
+
+            vec_int8 out = packus_epi16(
+                mulhi_epi16(slli_epi16(in_1, 16 - 9), in_1_pair), // 2**9 = 512
+                mulhi_epi16(slli_epi16(in_2, 16 - 9), in_2_pair)
+            ); // packus sets negative values to 0 and saturates at 255, which clamps negative values 
+
+            // 128 bit packus keeps the order, so no shuffle is needed
+            store_epi8(&output[i], out);
+        }
+    }
+#endif
+
+}; // namespace SIMD_NAMESPACE
+
+}; // namespace NNUE_UTILS
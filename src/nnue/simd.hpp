@@ -1,17 +1,39 @@
 #pragma once
 
-#if defined(__AVX512F__)
+// each instruction set gets its own namespace, as nnue_kernels.cpp is compiled once per
+// instruction set and the definitions below differ between builds.
+#if defined(__AVX512F__) && defined(__AVX512BW__)
     #define USE_AVX512
-    #define HAS_VNNI512 __AVX512VNNI__
+    #if defined(__AVX512VNNI__)
+        #define HAS_VNNI512
+        #define SIMD_NAMESPACE avx512_vnni
+        #define SIMD_NAME "avx512 vnni"
+    #else
+        #define SIMD_NAMESPACE avx512
+        #define SIMD_NAME "avx512"
+    #endif
 #elif defined(__AVX2__)
     #define USE_AVX2
-    // #define HAS_VNNI256 __AVXVNNI__
+    #if defined(__AVXVNNI__)
+        #define HAS_VNNI256
+        #define SIMD_NAMESPACE avx2_vnni
+        #define SIMD_NAME "avx2 vnni"
+    #else
+        #define SIMD_NAMESPACE avx2
+        #define SIMD_NAME "avx2"
+    #endif
+#elif defined(__SSE4_1__)
+    #define USE_SSE41
+    #define SIMD_NAMESPACE sse41
+    #define SIMD_NAME "sse4.1"
 #else
-    #error "bread requires the AVX2 instruction set to run."
+    #error "bread requires the SSE4.1 instruction set to run."
 #endif
 
 #include <immintrin.h>
 
+inline namespace SIMD_NAMESPACE {
+
 #ifdef USE_AVX512
     using vec_int8 = __m512i;
     using vec_uint8 = __m512i;
@@ -40,15 +62,15 @@
         return _mm512_set1_epi32(i);
     }
 
-    inline vec_int8 load_epi8(int8_t* ptr) {
+    inline vec_int8 load_epi8(const int8_t* ptr) {
         return _mm512_loadu_si512((const __m256i*)ptr);
     }
 
-    inline vec_int16 load_epi16(int16_t* ptr) {
+    inline vec_int16 load_epi16(const int16_t* ptr) {
         return _mm512_loadu_si512((const __m256i*)ptr);
     }
 
-    inline vec_int32 load_epi32(int32_t* ptr) {
+    inline vec_int32 load_epi32(const int32_t* ptr) {
         return _mm512_loadu_si512((const __m256i*)ptr);
     }
 
@@ -128,9 +150,53 @@
         return _mm512_srai_epi32(v, i);
     }
 
-    inline __m256 cvtsepi32_epi16(vec_int32 v) {
+    inline __m256i cvtsepi32_epi16(vec_int32 v) {
         return _mm512_cvtsepi32_epi16(v);
     }
+
+    inline vec_int32 load_epi16_to_epi32(const int16_t* ptr) { // sign extends INT32_PER_REG int16s
+        return _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)ptr));
+    }
+
+    inline vec_int32 sub_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm512_sub_epi32(v1, v2);
+    }
+
+    inline vec_int32 min_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm512_min_epi32(v1, v2);
+    }
+
+    inline vec_int32 max_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm512_max_epi32(v1, v2);
+    }
+
+    inline vec_int32 abs_epi32(vec_int32 v) {
+        return _mm512_abs_epi32(v);
+    }
+
+    inline vec_int32 mullo_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm512_mullo_epi32(v1, v2);
+    }
+
+    inline vec_int32 mul_epu32(vec_int32 v1, vec_int32 v2) {
+        return _mm512_mul_epu32(v1, v2);
+    }
+
+    inline vec_int32 srli_epi64(vec_int32 v, int i) {
+        return _mm512_srli_epi64(v, i);
+    }
+
+    inline vec_int32 slli_epi64(vec_int32 v, int i) {
+        return _mm512_slli_epi64(v, i);
+    }
+
+    inline vec_int32 or_si(vec_int32 v1, vec_int32 v2) {
+        return _mm512_or_si512(v1, v2);
+    }
+
+    inline vec_int32 xor_si(vec_int32 v1, vec_int32 v2) {
+        return _mm512_xor_si512(v1, v2);
+    }
     
 
     #ifdef HAS_VNNI512
@@ -211,23 +277,23 @@
         return _mm256_set1_epi32(i);
     }
 
-    inline vec_int8 load_epi8(int8_t* ptr) {
+    inline vec_int8 load_epi8(const int8_t* ptr) {
         return _mm256_loadu_si256((const __m256i*)ptr);
     }
 
-    inline vec_int8 load_epi8(uint8_t* ptr) {
+    inline vec_int8 load_epi8(const uint8_t* ptr) {
         return _mm256_loadu_si256((const __m256i*)ptr);
     }
 
-    inline vec_int16 load_epi16(int16_t* ptr) {
+    inline vec_int16 load_epi16(const int16_t* ptr) {
         return _mm256_loadu_si256((const __m256i*)ptr);
     }
 
-    inline vec_int16 load_epi16(uint16_t* ptr) {
+    inline vec_int16 load_epi16(const uint16_t* ptr) {
         return _mm256_loadu_si256((const __m256i*)ptr);
     }
 
-    inline vec_int32 load_epi32(int32_t* ptr) {
+    inline vec_int32 load_epi32(const int32_t* ptr) {
         return _mm256_loadu_si256((const __m256i*)ptr);
     }
 
@@ -315,9 +381,53 @@
         return _mm256_srai_epi32(v, i);
     }
 
+    inline vec_int32 load_epi16_to_epi32(const int16_t* ptr) { // sign extends INT32_PER_REG int16s
+        return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)ptr));
+    }
+
+    inline vec_int32 sub_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm256_sub_epi32(v1, v2);
+    }
+
+    inline vec_int32 min_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm256_min_epi32(v1, v2);
+    }
+
+    inline vec_int32 max_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm256_max_epi32(v1, v2);
+    }
+
+    inline vec_int32 abs_epi32(vec_int32 v) {
+        return _mm256_abs_epi32(v);
+    }
+
+    inline vec_int32 mullo_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm256_mullo_epi32(v1, v2);
+    }
+
+    inline vec_int32 mul_epu32(vec_int32 v1, vec_int32 v2) {
+        return _mm256_mul_epu32(v1, v2);
+    }
+
+    inline vec_int32 srli_epi64(vec_int32 v, int i) {
+        return _mm256_srli_epi64(v, i);
+    }
+
+    inline vec_int32 slli_epi64(vec_int32 v, int i) {
+        return _mm256_slli_epi64(v, i);
+    }
+
+    inline vec_int32 or_si(vec_int32 v1, vec_int32 v2) {
+        return _mm256_or_si256(v1, v2);
+    }
+
+    inline vec_int32 xor_si(vec_int32 v1, vec_int32 v2) {
+        return _mm256_xor_si256(v1, v2);
+    }
+
     #ifdef HAS_VNNI256
         inline vec_int32 dpbusd_epi32(vec_int32 sum, vec_int8 v1, vec_int8 v2) {
-            return _mm256_dpbusd_epi32(sum, v1, v2);
+            return _mm256_dpbusd_avx_epi32(sum, v1, v2);
         }
     #else
         inline vec_int32 dpbusd_epi32(vec_int32 sum, vec_int8 v1, vec_int8 v2) {
@@ -351,7 +461,203 @@
 
 #endif
 
+#ifdef USE_SSE41
+    using vec_int8 = __m128i;
+    using vec_uint8 = __m128i;
+    using vec_int16 = __m128i;
+    using vec_uint16 = __m128i;
+    using vec_int32 = __m128i;
+    using vec_uint32 = __m128i;
+
+    inline vec_int8 setzero_epi8() {
+        return _mm_setzero_si128();
+    }
+
+    inline vec_int16 setzero_epi16() {
+        return _mm_setzero_si128();
+    }
+
+    inline vec_int32 setzero_epi32() {
+        return _mm_setzero_si128();
+    }
+
+    inline vec_int16 set1_epi16(int i) {
+        return _mm_set1_epi16(i);
+    }
+
+    inline vec_int32 set1_epi32(int i) {
+        return _mm_set1_epi32(i);
+    }
+
+    inline vec_int8 load_epi8(const int8_t* ptr) {
+        return _mm_loadu_si128((const __m128i*)ptr);
+    }
+
+    inline vec_int8 load_epi8(const uint8_t* ptr) {
+        return _mm_loadu_si128((const __m128i*)ptr);
+    }
+
+    inline vec_int16 load_epi16(const int16_t* ptr) {
+        return _mm_loadu_si128((const __m128i*)ptr);
+    }
+
+    inline vec_int32 load_epi32(const int32_t* ptr) {
+        return _mm_loadu_si128((const __m128i*)ptr);
+    }
+
+    inline void store_epi8(int8_t* ptr, vec_int8 v) {
+        _mm_storeu_si128((__m128i*)ptr, v);
+    }
+
+    inline void store_epi8(uint8_t* ptr, vec_int8 v) {
+        _mm_storeu_si128((__m128i*)ptr, v);
+    }
+
+    inline void store_epi16(int16_t* ptr, vec_int16 v) {
+        _mm_storeu_si128((__m128i*)ptr, v);
+    }
+
+    inline void store_epi32(int32_t* ptr, vec_int32 v) {
+        _mm_storeu_si128((__m128i*)ptr, v);
+    }
+
+    inline vec_int8 packs_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_packs_epi16(v1, v2);
+    }
+
+    inline vec_int16 packs_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm_packs_epi32(v1, v2);
+    }
+
+    inline vec_int8 packus_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_packus_epi16(v1, v2);
+    }
+
+    inline vec_int16 packus_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm_packus_epi32(v1, v2);
+    }
+
+    inline vec_int8 max_epi8(vec_int8 v1, vec_int8 v2) {
+        return _mm_max_epi8(v1, v2);
+    }
+
+    inline vec_int8 min_epi8(vec_int8 v1, vec_int8 v2) {
+        return _mm_min_epi8(v1, v2);
+    }
+
+    inline vec_int16 max_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_max_epi16(v1, v2);
+    }
+
+    inline vec_int16 min_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_min_epi16(v1, v2);
+    }
+
+    inline vec_int16 add_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_add_epi16(v1, v2);
+    }
+
+    inline vec_int32 add_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm_add_epi32(v1, v2);
+    }
+
+    inline vec_int16 sub_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_sub_epi16(v1, v2);
+    }
+
+    inline vec_int32 madd_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_madd_epi16(v1, v2);
+    }
+
+    inline vec_int16 mullo_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_mullo_epi16(v1, v2);
+    }
+
+    inline vec_int16 mulhi_epi16(vec_int16 v1, vec_int16 v2) {
+        return _mm_mulhi_epi16(v1, v2);
+    }
+
+    inline vec_int16 maddubs_epi16(vec_int8 v1, vec_int8 v2) {
+        return _mm_maddubs_epi16(v1, v2);
+    }
+
+    inline vec_int16 slli_epi16(vec_int16 v, int i) {
+        return _mm_slli_epi16(v, i);
+    }
+
+    inline vec_int32 srai_epi32(vec_int32 v, int i) {
+        return _mm_srai_epi32(v, i);
+    }
+
+    inline vec_int32 load_epi16_to_epi32(const int16_t* ptr) { // sign extends INT32_PER_REG int16s
+        return _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)ptr));
+    }
+
+    inline vec_int32 sub_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm_sub_epi32(v1, v2);
+    }
+
+    inline vec_int32 min_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm_min_epi32(v1, v2);
+    }
+
+    inline vec_int32 max_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm_max_epi32(v1, v2);
+    }
+
+    inline vec_int32 abs_epi32(vec_int32 v) {
+        return _mm_abs_epi32(v);
+    }
+
+    inline vec_int32 mullo_epi32(vec_int32 v1, vec_int32 v2) {
+        return _mm_mullo_epi32(v1, v2);
+    }
+
+    inline vec_int32 mul_epu32(vec_int32 v1, vec_int32 v2) {
+        return _mm_mul_epu32(v1, v2);
+    }
+
+    inline vec_int32 srli_epi64(vec_int32 v, int i) {
+        return _mm_srli_epi64(v, i);
+    }
+
+    inline vec_int32 slli_epi64(vec_int32 v, int i) {
+        return _mm_slli_epi64(v, i);
+    }
+
+    inline vec_int32 or_si(vec_int32 v1, vec_int32 v2) {
+        return _mm_or_si128(v1, v2);
+    }
+
+    inline vec_int32 xor_si(vec_int32 v1, vec_int32 v2) {
+        return _mm_xor_si128(v1, v2);
+    }
+
+    inline vec_int32 dpbusd_epi32(vec_int32 sum, vec_int8 v1, vec_int8 v2) {
+        const vec_int16 prod = maddubs_epi16(v1, v2);
+        return add_epi32(sum, madd_epi16(prod, set1_epi16(1)));
+    }
+
+    inline uint8_t nonzero_mask_epi32(vec_int32 v) { // 4 bits
+        uint8_t z_bitmask = _mm_movemask_ps(
+            _mm_castsi128_ps(_mm_cmpeq_epi32(v, _mm_setzero_si128()))
+        );
+        return ~z_bitmask & 0xF;
+    }
+
+    // defined when USE_SSE41 only:
+
+    inline int reduce1_epi32(vec_int32 v) {
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0b01'00'11'10));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0b10'11'00'01));
+        return _mm_cvtsi128_si32(v);
+    }
+
+#endif
+
 constexpr int NUM_AVX_REGISTERS = 8;
 constexpr int INT32_PER_REG = sizeof(vec_int32) / sizeof(int32_t);
 constexpr int INT16_PER_REG = sizeof(vec_int16) / sizeof(int16_t);
-constexpr int INT8_PER_REG = sizeof(vec_int8) / sizeof(int8_t);
\ No newline at end of file
+constexpr int INT8_PER_REG = sizeof(vec_int8) / sizeof(int8_t);
+
+}; // namespace SIMD_NAMESPACE
@@ -27,16 +27,13 @@ UNACTIVE_TUNEABLE(cphis, int, 209, 0, 5000, 41, 0.002);
 
 template<>
 SortedMoveGen<GenType::NORMAL>::SortedMoveGen(
-    Movelist* to_search, Piece prev_piece, Square prev_to,
-    Piece prev_piece2, Square prev_to2, NnueBoard& pos, int depth,
-    KillerMoves& killers, FromToHistory& hist,
+    Movelist* to_search, int16_t* cont_hist_row, int16_t* cont_hist2_row,
+    NnueBoard& pos, int depth, KillerMoves& killers, FromToHistory& hist,
     ContinuationHistory& cont_hist, ContinuationHistory& cont_hist2, CaptureHistory& capt_hist
     ):
     to_search(to_search),
-    prev_piece(prev_piece),
-    prev_to(prev_to),
-    prev_piece2(prev_piece2),
-    prev_to2(prev_to2),
+    cont_hist_row(cont_hist_row),
+    cont_hist2_row(cont_hist2_row),
     pos(pos),
     depth(depth),
     killer_moves(killers),
@@ -48,11 +45,9 @@ SortedMoveGen<GenType::NORMAL>::SortedMoveGen(
 
 template<>
 SortedMoveGen<GenType::QSEARCH>::SortedMoveGen(
-    Piece prev_piece, Square prev_to, NnueBoard& pos,
+    NnueBoard& pos,
     KillerMoves& killers, FromToHistory& hist, ContinuationHistory& cont_hist, CaptureHistory& capt_hist
     ):
-    prev_piece(prev_piece),
-    prev_to(prev_to),
     pos(pos),
     killer_moves(killers),
     history(hist),
@@ -145,11 +140,11 @@ void SortedMoveGen<GenType::NORMAL>::set_score(Move& move){
 
         score += q_his * history.get(stm, from.index(), to) / 8192;
 
-        if (prev_piece != int(Piece::NONE) && prev_to != int(Square::underlying::NO_SQ))
-            score += q_cthis * cont_history.get(prev_piece, prev_to, piece, to) / 8192;
+        if (cont_hist_row != nullptr)
+            score += q_cthis * ContinuationHistory::get(cont_hist_row, piece, to) / 8192;
 
-        if (prev_piece2 != int(Piece::NONE) && prev_to2 != int(Square::underlying::NO_SQ))
-            score += q_cthis2 * cont_history2.get(prev_piece2, prev_to2, piece, to) / 8192;
+        if (cont_hist2_row != nullptr)
+            score += q_cthis2 * ContinuationHistory::get(cont_hist2_row, piece, to) / 8192;
 
         score = std::clamp(score, WORST_MOVE_SCORE + 1, BEST_MOVE_SCORE - 1);
 
@@ -173,12 +168,17 @@ void SortedMoveGen<MoveGenType>::set_tt_move(Move move){
     tt_move = move;
 }
 
+template<GenType MoveGenType>
+void SortedMoveGen<MoveGenType>::set_to_search_start(int start){
+    to_search_start = start;
+}
+
 template<GenType MoveGenType>
 bool SortedMoveGen<MoveGenType>::next(Move& move){
     if (to_search != NULL){
-        if (move_idx == to_search->size())
+        if (to_search_start + move_idx == to_search->size())
             return false;
-        move = (*to_search)[move_idx];
+        move = (*to_search)[to_search_start + move_idx];
         move_idx++;
         return true;
     }
@@ -337,17 +337,15 @@ void SortedMoveGen<GenType::NORMAL>::update_capture_history(Move best_move, int
 }
 
 template<>
-void SortedMoveGen<GenType::NORMAL>::update_cont_history(Piece prev_piece, Square prev_to, Piece piece, Square to, int bonus){
-    if (prev_piece != int(Piece::NONE) && prev_to != int(Square::underlying::NO_SQ)
-        && piece != int(Piece::NONE) && to != int(Square::underlying::NO_SQ))
-        cont_history.apply_bonus(cont_history.get(prev_piece, prev_to, piece, to), bonus);
+void SortedMoveGen<GenType::NORMAL>::update_cont_history(int16_t* row, Piece piece, Square to, int bonus){
+    if (row != nullptr && piece != int(Piece::NONE) && to != int(Square::underlying::NO_SQ))
+        cont_history.apply_bonus(ContinuationHistory::get(row, piece, to), bonus);
 }
 
 template<>
-void SortedMoveGen<GenType::NORMAL>::update_cont_history2(Piece prev_piece2, Square prev_to2, Piece piece, Square to, int bonus){
-    if (prev_piece2 != int(Piece::NONE) && prev_to2 != int(Square::underlying::NO_SQ)
-        && piece != int(Piece::NONE) && to != int(Square::underlying::NO_SQ))
-        cont_history2.apply_bonus(cont_history2.get(prev_piece2, prev_to2, piece, to), bonus);
+void SortedMoveGen<GenType::NORMAL>::update_cont_history2(int16_t* row, Piece piece, Square to, int bonus){
+    if (row != nullptr && piece != int(Piece::NONE) && to != int(Square::underlying::NO_SQ))
+        cont_history2.apply_bonus(ContinuationHistory::get(row, piece, to), bonus);
 }
 
 template class SortedMoveGen<GenType::QSEARCH>;
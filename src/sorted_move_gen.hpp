@@ -33,27 +33,26 @@ template<GenType MoveGenType>
 class SortedMoveGen {
     public:
 
-    Piece prev_piece;
-    Square prev_to;
-    Piece prev_piece2 = Piece::NONE;
-    Square prev_to2 = Square::NO_SQ;
+    // continuation history rows of the moves made one and two plies ago, may be null
+    int16_t* cont_hist_row = nullptr;
+    int16_t* cont_hist2_row = nullptr;
     NnueBoard& pos;
 
-    SortedMoveGen(Movelist* to_search, Piece prev_piece, Square prev_to,
-        Piece prev_piece2, Square prev_to2, NnueBoard& pos, int depth,
-        KillerMoves& killers, FromToHistory& hist,
+    SortedMoveGen(Movelist* to_search, int16_t* cont_hist_row, int16_t* cont_hist2_row,
+        NnueBoard& pos, int depth, KillerMoves& killers, FromToHistory& hist,
         ContinuationHistory& cont_hist, ContinuationHistory& cont_hist2, CaptureHistory& capt_hist);
-    SortedMoveGen(Piece prev_piece, Square prev_to, NnueBoard& pos,
+    SortedMoveGen(NnueBoard& pos,
         KillerMoves& killers, FromToHistory& hist, ContinuationHistory& cont_hist, CaptureHistory& capt_hist);
 
     void set_tt_move(Move move);
+    void set_to_search_start(int start);
     bool next(Move& move);
     bool empty();
     int index();
     void update_history(Move best_move, int depth);
     void update_capture_history(Move best_move, int depth);
-    void update_cont_history(Piece prev_piece, Square prev_to, Piece piece, Square to, int bonus);
-    void update_cont_history2(Piece prev_piece2, Square prev_to2, Piece piece, Square to, int bonus);
+    void update_cont_history(int16_t* row, Piece piece, Square to, int bonus);
+    void update_cont_history2(int16_t* row, Piece piece, Square to, int bonus);
     void set_score(Move& move);
     void prepare_capture_sort();
     void prepare_quiet_sort();
@@ -75,6 +74,7 @@ class SortedMoveGen {
     Bitboard attacked_by_pawn;
     std::array<Bitboard, 6> check_squares;
     Movelist* to_search = NULL;
+    int to_search_start = 0; // moves of to_search before this index are skipped
 
     int depth = DEPTH_UNSEARCHED;
     int move_idx = 0;
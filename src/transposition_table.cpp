@@ -5,7 +5,7 @@ TranspositionTable::TranspositionTable(){
 };
 
 TranspositionTable::~TranspositionTable(){
-    delete[] entries;
+    Memory::free_large(clusters, size * sizeof(TCluster));
 };
 
 void TranspositionTable::info(){
@@ -16,9 +16,9 @@ void TranspositionTable::info(){
     int num_upper = 0;
     int num_lower = 0;
 
-    for (int i = 0; i < size; i++){
-        TEntry entry = entries[i];
-        if (entry.zobrist_hash != 0){
+    for (int i = 0; i < size * TT_CLUSTER_SIZE; i++){
+        TEntry entry = clusters[i / TT_CLUSTER_SIZE].entries[i % TT_CLUSTER_SIZE];
+        if (is_used(entry)){
             used++;
 
             num_move += (entry.move != Move::NO_MOVE);
@@ -40,12 +40,14 @@ void TranspositionTable::info(){
             }
         }
     }
-    int used_percentage = used*100/size;
+    int used_percentage = used*100/(size * TT_CLUSTER_SIZE);
 
     std::cout << "=================================" << std::endl;
     std::cout << "transposition table:" << std::endl;
     std::cout << "size " << size_mb << " MB" << std::endl;
-    std::cout << "number of entries " << size << std::endl;
+    std::cout << "memory " << Memory::page_type_name(page_type) << std::endl;
+    std::cout << "number of clusters " << size << std::endl;
+    std::cout << "number of entries " << size * TT_CLUSTER_SIZE << std::endl;
     std::cout << "used entries " << used << std::endl;
     std::cout << "used percentage " << used_percentage << "%" << std::endl;
     if (used != 0){
@@ -66,75 +68,177 @@ void TranspositionTable::allocateMB(int new_size){
     new_size = std::max(new_size, TT_MIN_SIZE);
     new_size = std::min(new_size, TT_MAX_SIZE);
 
-    // closest power of 2 to 1'000'000 / 16 is 2^16 = 65536
-    assert(sizeof(TEntry) == 16);
-    constexpr int entries_in_one_mb = 65536;
-    size = new_size * entries_in_one_mb;
+    // closest power of 2 to 1'000'000 / 64 is 2^14 = 16384
+    static_assert(sizeof(TEntry) == 10);
+    static_assert(sizeof(TCluster) == 64);
+    constexpr int clusters_in_one_mb = 16384;
+
+    Memory::free_large(clusters, size * sizeof(TCluster));
+
+    size = new_size * clusters_in_one_mb;
     size_mb = new_size;
 
-    delete[] entries;
-    entries = new TEntry[size];
+    // zeroed memory is an empty table, as TFlag::NO_FLAG is 0.
+    static_assert(static_cast<int>(TFlag::NO_FLAG) == 0);
+    clusters = static_cast<TCluster*>(
+        Memory::allocate_large(size * sizeof(TCluster), use_huge_pages, page_type)
+    );
+    if (clusters == nullptr)
+        throw std::bad_alloc();
+
+    // touch the memory now rather than during the first search, with each
+    // thread writing its own slice so pages are spread over NUMA nodes.
+    parallel_clear();
+    Memory::confirm_page_type(clusters, page_type);
+}
+
+void TranspositionTable::set_huge_pages(bool use_huge_pages){
+    this->use_huge_pages = use_huge_pages;
+    allocateMB(size_mb);
+}
+
+Memory::PageType TranspositionTable::get_page_type(){
+    return page_type;
+}
+
+// the least valuable entry of a cluster is the one that gets replaced.
+// shallow, old and non exact entries are the cheapest to lose.
+int TranspositionTable::replacement_value(TEntry& entry){
+    return entry.depth
+         + 2 * (entry.flag() == TFlag::EXACT)
+         + 2 * entry.ttpv()
+         - 8 * relative_age(entry);
 }
 
 void TranspositionTable::store(uint64_t zobrist, int value, int static_eval, int depth,
-                               Move move, TFlag flag, int move_number, bool ttpv){
+                               Move move, TFlag flag, bool ttpv){
 
     assert(move != Move::NULL_MOVE);
 
     // no need to store the side to move, as it is in the zobrist hash.
-    TEntry* entry = &entries[zobrist & (size - 1)];
+    TCluster* cluster = &clusters[zobrist & (size - 1)];
+    uint16_t key = compress_key(zobrist);
+
+    // use the slot holding the same position, or the first empty slot.
+    // otherwise, replace the least valuable entry of the cluster.
+    TEntry* entry = &cluster->entries[0];
+    for (int i = 0; i < TT_CLUSTER_SIZE; i++){
+        TEntry* candidate = &cluster->entries[i];
+        if (!is_used(*candidate) || candidate->key == key){
+            entry = candidate;
+            break;
+        }
+        if (replacement_value(*candidate) < replacement_value(*entry))
+            entry = candidate;
+    }
+
+    bool same_position = is_used(*entry) && entry->key == key;
 
     // we replace the old entry if:
-    // - the old entry is empty
-    // - the old entry is more than 4 moves older than the recent entry
+    // - the old entry holds another position (it was the least valuable in the cluster)
+    // - the old entry was written by a previous search
     // - the new depth is greater than the old depth
     // - the new depth is nonzero and an exact entry
-    if (move_number / 2 > entry->move_number() + 2 ||
-        depth > entry->depth - 1 - 2*ttpv || // this will be true if the old entry is empty
+    if (!same_position ||
+        relative_age(*entry) != 0 ||
+        depth > entry->depth - 1 - 2*ttpv ||
         (depth != DEPTH_QSEARCH && flag == TFlag::EXACT))
     {
         // add move if the old entry didn't hold the same position or if the new move is better
-        if (entry->zobrist_hash != zobrist || move != Move::NO_MOVE)
+        if (!same_position || move != Move::NO_MOVE)
             entry->move = move.move();
 
-        entry->zobrist_hash = zobrist;
+        entry->key = key;
         entry->value = value;
         entry->static_eval = static_eval;
         entry->depth = depth;
-        entry->move_num_tflag_ttpv = (static_cast<uint8_t>(move_number / 2) << 3) | (static_cast<uint8_t>(flag) << 1) | ttpv;
+        entry->gen_tflag_ttpv = (static_cast<uint8_t>(generation) << 3) | (static_cast<uint8_t>(flag) << 1) | ttpv;
     };
 }
 
 TTData TranspositionTable::probe(bool& is_hit, uint64_t zobrist, bool pv){
     assert((size & (size - 1)) == 0);
-    TEntry* entry = &entries[zobrist & (size - 1)];
-    is_hit = (entry->zobrist_hash == zobrist);
+    TCluster* cluster = &clusters[zobrist & (size - 1)];
+    uint16_t key = compress_key(zobrist);
+
+    for (int i = 0; i < TT_CLUSTER_SIZE; i++){
+        TEntry* entry = &cluster->entries[i];
+        if (entry->key == key && is_used(*entry)){
+            is_hit = true;
+            return TTData(entry, pv);
+        }
+    }
+
+    is_hit = false;
+    return TTData();
+}
 
-    if (is_hit)
-        return TTData(entry, pv);
-    else
-        return TTData();
+void TranspositionTable::new_search(){
+    // the oldest generation in use is about to share its 5 bits with the new one. if it holds
+    // lazily cleared entries, they would be visible again, so the table is really cleared.
+    bool has_cleared_entries = searches_since_clear < generations_in_use - 1;
+    if (generations_in_use == TT_NUM_GENERATIONS && has_cleared_entries){
+        parallel_clear();
+        return;
+    }
+
+    generation = (generation + 1) & (TT_NUM_GENERATIONS - 1);
+    searches_since_clear = std::min(searches_since_clear + 1, TT_NUM_GENERATIONS);
+    generations_in_use = std::min(generations_in_use + 1, TT_NUM_GENERATIONS);
 }
 
 void TranspositionTable::clear(){
     std::lock_guard<std::mutex> lock(clear_mutex);
-    for (size_t i = 0; i < size; i++) {
-        entries[i] = TEntry();
+    // every entry written so far gets a relative age greater than 0, and is ignored.
+    // this needs a generation that no entry in the table has.
+    if (lazy_clear && generations_in_use < TT_NUM_GENERATIONS){
+        generation = (generation + 1) & (TT_NUM_GENERATIONS - 1);
+        searches_since_clear = 0;
+        generations_in_use++;
+        return;
+    }
+
+    parallel_clear();
+}
+
+void TranspositionTable::parallel_clear(){
+    int threads_count = std::max(1, std::min<int>(num_threads, size));
+    size_t slice_size = size / threads_count;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; t++){
+        size_t start = t * slice_size;
+        size_t end = (t == threads_count - 1) ? size : start + slice_size;
+        threads.emplace_back([this, start, end](){
+            std::fill(clusters + start, clusters + end, TCluster());
+        });
     }
+
+    for (auto& thread: threads)
+        thread.join();
+
+    searches_since_clear = TT_NUM_GENERATIONS;
+    generations_in_use = 1;
 }
 
+// only entries of the current search are counted
 int TranspositionTable::hashfull(){
     int used = 0;
     for (int i = 0; i < 1000; i++){
-        used += (entries[i].zobrist_hash != 0);
+        TEntry& entry = clusters[i / TT_CLUSTER_SIZE].entries[i % TT_CLUSTER_SIZE];
+        used += is_used(entry) && relative_age(entry) == 0;
     }
     return used;
 }
 
 void TranspositionTable::save_to_stream(std::ofstream& ofs){
-    ofs.write(reinterpret_cast<const char*>(entries), size * sizeof(TEntry));
+    ofs.write(reinterpret_cast<const char*>(clusters), size * sizeof(TCluster));
 }
 
 void TranspositionTable::load_from_stream(std::ifstream& ifs){
-    ifs.read(reinterpret_cast<char*>(entries), size * sizeof(TEntry));
+    ifs.read(reinterpret_cast<char*>(clusters), size * sizeof(TCluster));
+
+    // the loaded entries can have any generation, and are all visible.
+    searches_since_clear = TT_NUM_GENERATIONS;
+    generations_in_use = TT_NUM_GENERATIONS;
 }
\ No newline at end of file
@@ -2,8 +2,11 @@
 
 #include "chess.hpp"
 #include "misc.hpp"
+#include "memory.hpp"
 #include <fstream>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 
 enum class TFlag: uint8_t {
@@ -15,36 +18,46 @@ enum class TFlag: uint8_t {
 
 // side to move is not stored in the transposition table as it is in the zobrist hash
 struct TEntry {
-    uint64_t zobrist_hash      = 0; // 8 bytes
+    uint16_t key               = 0; // 2 bytes -> upper 16 bits of the zobrist hash, the lower bits select the cluster
     int16_t value              = NO_VALUE; // 2 bytes
     int16_t static_eval        = NO_VALUE; // 2 bytes
     uint16_t move              = 0; // 2 bytes
     uint8_t depth              = 0; // 1 byte
-    uint8_t move_num_tflag_ttpv  = 0; // 1 byte -> contains move_num: 5 bits (32 values), flag: 2 bits (4 values), pv: 1 bit (2 values)
+    uint8_t gen_tflag_ttpv     = 0; // 1 byte -> contains generation: 5 bits (32 values), flag: 2 bits (4 values), pv: 1 bit (2 values)
     // ==============
-    // ----> total = 8 + 8 = 16 bytes
+    // ----> total = 8 + 2 = 10 bytes
 
-    int move_number(){
-        return static_cast<int>(move_num_tflag_ttpv >> 3);
+    int generation(){
+        return static_cast<int>(gen_tflag_ttpv >> 3);
     };
 
     TFlag flag(){
-        return static_cast<TFlag>((move_num_tflag_ttpv >> 1) & 0b00000011);
+        return static_cast<TFlag>((gen_tflag_ttpv >> 1) & 0b00000011);
     };
 
     bool ttpv(){
-        return static_cast<bool>(move_num_tflag_ttpv & 0b00000001);
+        return static_cast<bool>(gen_tflag_ttpv & 0b00000001);
+    };
+
+    // every stored entry has a bound type, so an entry without flag was never written to.
+    bool empty(){
+        return flag() == TFlag::NO_FLAG;
     };
 
     TEntry(){};
 };
 
+// a cluster fills exactly one cache line, so a probe costs a single memory fetch.
+struct alignas(64) TCluster {
+    TEntry entries[TT_CLUSTER_SIZE]; // 6 * 10 = 60 bytes
+    char padding[64 - TT_CLUSTER_SIZE * sizeof(TEntry)];
+};
+
 struct TTData {
     int value               = NO_VALUE;
     int static_eval         = NO_VALUE;
     Move move               = Move::NO_MOVE;
     int depth               = 0;
-    int move_number         = 0;
     TFlag flag              = TFlag::NO_FLAG;
     bool ttpv               = false;
 
@@ -56,7 +69,6 @@ struct TTData {
             move(entry->move),
             depth(entry->depth),
             flag(entry->flag()),
-            move_number(entry->move_number()),
             ttpv(entry->ttpv() || pv)
             {};
 };
@@ -69,20 +81,61 @@ class TranspositionTable {
 
     void allocateMB(int new_size);
 
-    void store(uint64_t zobrist, int value, int eval, int depth, Move move, TFlag flag, int move_number, bool ttpv);
+    void set_huge_pages(bool use_huge_pages);
+    Memory::PageType get_page_type();
+
+    void store(uint64_t zobrist, int value, int eval, int depth, Move move, TFlag flag, bool ttpv);
 
     TTData probe(bool& is_hit, uint64_t zobrist, bool pv);
 
+    void new_search();
+
     void clear();
 
     int hashfull();
 
+    void prefetch(uint64_t zobrist){
+        __builtin_prefetch(&clusters[zobrist & (size - 1)]);
+    };
+
     void save_to_stream(std::ofstream& ofs);
     void load_from_stream(std::ifstream& ifs);
 
-    TEntry* entries = nullptr;
-    size_t size = 0;
+    TCluster* clusters = nullptr;
+    size_t size = 0; // number of clusters
+
+    // when set, clear() only invalidates the entries of previous generations
+    // instead of walking the whole table.
+    bool lazy_clear = true;
+
+    // number of threads used to clear and initialise the table.
+    int num_threads = 1;
     private:
     int size_mb = 0;
     std::mutex clear_mutex;
+
+    bool use_huge_pages = true;
+    Memory::PageType page_type = Memory::PageType::DEFAULT;
+
+    int generation = 0; // 5 bits, incremented for every search
+    int searches_since_clear = TT_NUM_GENERATIONS; // entries older than this were lazily cleared
+    // number of generations, ending with the current one, that entries in the table may have.
+    // while it stays below TT_NUM_GENERATIONS, no generation wraps around to the current one.
+    int generations_in_use = 1;
+
+    int relative_age(TEntry& entry){
+        return (generation - entry.generation()) & (TT_NUM_GENERATIONS - 1);
+    };
+
+    bool is_used(TEntry& entry){
+        return !entry.empty() && relative_age(entry) <= searches_since_clear;
+    };
+
+    static uint16_t compress_key(uint64_t zobrist){
+        return static_cast<uint16_t>(zobrist >> 48);
+    };
+
+    int replacement_value(TEntry& entry);
+
+    void parallel_clear();
 };
\ No newline at end of file
@@ -1,12 +1,118 @@
 #include "uci.hpp"
 
-Worker::Worker(bool is_main_thread, TranspositionTable& tt, std::atomic<int64_t>& nodes)
-    : engine(is_main_thread, tt, nodes) {};
+Worker::Worker(bool is_main_thread, TranspositionTable& tt, NodeCounters& nodes)
+    : engine(is_main_thread, tt, nodes) {
+    thread = std::thread(&Worker::idle_loop, this);
+};
+
+Worker::~Worker(){
+    engine.interrupt_flag = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exit = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void Worker::idle_loop(){
+    while (true){
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]{ return searching || exit; });
+        if (exit)
+            return;
+        lock.unlock();
+
+        engine.iterative_deepening(limit);
+        engine.searching = false;
+
+        lock.lock();
+        searching = false;
+        lock.unlock();
+        cv.notify_all();
+    }
+}
+
+void Worker::start_searching(SearchLimit limit){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->limit = limit;
+        searching = true;
+    }
+    cv.notify_all();
+}
+
+void Worker::wait_for_search_finished(){
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]{ return !searching; });
+}
+
+SearchTimer::SearchTimer(){
+    thread = std::thread(&SearchTimer::run, this);
+}
+
+SearchTimer::~SearchTimer(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exit = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void SearchTimer::run(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!exit){
+        if (!armed){
+            cv.wait(lock);
+            continue;
+        }
 
-WorkerPool::WorkerPool(int size, TranspositionTable& tt, std::atomic<int64_t>& nodes){
+        // woken up early when the limit changes, the deadline is then recomputed.
+        auto deadline = start_time + std::chrono::milliseconds(time_limit);
+        cv.wait_until(lock, deadline);
+        if (armed && std::chrono::steady_clock::now() >= start_time + std::chrono::milliseconds(time_limit)){
+            for (Engine* engine: engines)
+                engine->interrupt_flag = true;
+            armed = false;
+        }
+    }
+}
+
+void SearchTimer::start(std::vector<Engine*> engines, SearchLimit limit){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->engines = engines;
+        start_time = std::chrono::steady_clock::now();
+        time_limit = limit.value;
+        armed = (limit.type == LimitType::Time);
+    }
+    cv.notify_all();
+}
+
+void SearchTimer::set_time_limit(int time_limit){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->time_limit = time_limit;
+        armed = true;
+    }
+    cv.notify_all();
+}
+
+// once this returns, the timer no longer touches the interrupt flags.
+void SearchTimer::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        armed = false;
+    }
+    cv.notify_all();
+}
+
+WorkerPool::WorkerPool(int size, TranspositionTable& tt, NodeCounters& nodes){
     for (int i = 0; i < size; i++) {
         bool is_main = (i == 0);
         workers.emplace_back(is_main, tt, nodes);
+        workers.back().engine.thread_id = i;
     }
 };
 
@@ -14,9 +120,10 @@ int WorkerPool::size(){
     return workers.size();
 }
 
-void WorkerPool::clear_state(){
+// the transposition table is shared, so it is cleared once by the caller.
+void WorkerPool::clear_histories(){
     for (auto& worker: workers)
-        worker.engine.clear_state();
+        worker.engine.clear_histories();
 }
 
 void WorkerPool::synchronize(){
@@ -24,6 +131,13 @@ void WorkerPool::synchronize(){
         worker.engine.pos.synchronize();
 }
 
+void WorkerPool::reset_finny_tables(){
+    for (auto& worker: workers){
+        worker.engine.pos.reset_finny_table();
+        worker.engine.pos.synchronize();
+    }
+}
+
 void WorkerPool::set_tablebase_loaded(bool tablebase_loaded){
     for (auto& worker: workers)
         worker.engine.tablebase_loaded = tablebase_loaded;
@@ -34,28 +148,57 @@ void WorkerPool::set_is_nonsense(bool is_nonsense){
         worker.engine.is_nonsense = is_nonsense;
 }
 
+void WorkerPool::set_eval_cache(bool enabled){
+    for (auto& worker: workers)
+        worker.engine.pos.set_eval_cache(enabled);
+}
+
 void WorkerPool::set_position(NnueBoard& pos){
     for (auto& worker: workers)
-        worker.engine.pos = pos;
+        worker.engine.pos.set_position(pos);
 }
 
 void WorkerPool::update_limit(SearchLimit limit){
     for (auto& worker: workers)
         worker.engine.limit.store(limit);
+
+    if (limit.type == LimitType::Time)
+        timer->set_time_limit(main().engine.adjust_limit(limit).value);
 };
 
 void WorkerPool::start_searching(SearchLimit limit){
+    // reset every counter before any thread starts, so that no count of the
+    // previous search is seen by the other threads.
+    // the main thread waits for the helpers that are still searching before voting.
+    main().engine.helpers.clear();
+    std::vector<Engine*> engines;
+    for (auto& worker: workers){
+        engines.push_back(&worker.engine);
+        worker.engine.nodes.reset();
+        worker.engine.completed_depth = 0;
+        worker.engine.searching = true;
+        if (&worker != &main())
+            main().engine.helpers.push_back(&worker.engine);
+    }
+
+    timer->start(engines, main().engine.adjust_limit(limit));
+
     for (auto& worker: workers)
-        worker.thread = std::thread(&Engine::iterative_deepening, &worker.engine, limit);
+        worker.start_searching(limit);
 }
 
-void WorkerPool::interrupt_and_join_threads(){
+void WorkerPool::interrupt_and_wait(){
+    timer->stop();
+
+    // interrupt every worker before waiting, so they all stop at the same time.
     for (auto& worker: workers)
-        if (worker.thread.joinable()){
-            worker.engine.interrupt_flag = true;
-            worker.thread.join();
-            worker.engine.interrupt_flag = false;
-        }
+        worker.engine.interrupt_flag = true;
+
+    for (auto& worker: workers){
+        worker.wait_for_search_finished();
+        worker.engine.interrupt_flag = false;
+    }
+    main().engine.helpers.clear();
 }
 
 Worker& WorkerPool::main(){
@@ -75,7 +218,12 @@ bool UCIAgent::process_uci_command(std::string command){
         std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
         std::cout << "option name Hash type spin default 256 min " << TT_MIN_SIZE << " max " << TT_MAX_SIZE << std::endl;
         std::cout << "option name Threads type spin default 1 min 1 max 1024" << std::endl;
+        std::cout << "option name MultiPV type spin default 1 min 1 max 256" << std::endl;
         std::cout << "option name Nonsense type check default false" << std::endl;
+        std::cout << "option name LazyClear type check default true" << std::endl;
+        std::cout << "option name EvalCache type check default false" << std::endl;
+        std::cout << "option name LargePages type check default true" << std::endl;
+        std::cout << "option name EvalFile type string default <embedded>" << std::endl;
         // spsa tune options
         auto& tuneables = SPSA::get_values();
         for (const auto& [name, info] : tuneables) {
@@ -83,6 +231,7 @@ bool UCIAgent::process_uci_command(std::string command){
                       << " min " << info.min << " max " << info.max << std::endl;
         }
 
+        std::cout << "info string nnue uses " << NNUE::kernels_name() << " kernels" << std::endl;
         std::cout << "uciok" << std::endl;
     } else if (first == "setoption"){
         process_setoption(parsed_command);
@@ -91,31 +240,37 @@ bool UCIAgent::process_uci_command(std::string command){
         std::cout << "readyok" << std::endl;
 
     } else if (first == "ucinewgame"){
-        workers.interrupt_and_join_threads();
+        workers.interrupt_and_wait();
         pos.setFen(constants::STARTPOS);
-        workers.clear_state();
+        clear_hash();
+        workers.clear_histories();
 
     } else if (first == "position"){
         process_position(parsed_command);
     
     } else if (first == "bench"){
+        workers.interrupt_and_wait();
         process_bench(parsed_command);
 
     } else if (first == "eval"){
         process_eval(parsed_command);
 
+    } else if (first == "evalbatch"){
+        workers.interrupt_and_wait();
+        process_evalbatch(parsed_command);
+
     } else if (first == "go"){
-        workers.interrupt_and_join_threads();
+        workers.interrupt_and_wait();
         process_go(parsed_command);
 
     } else if (first == "ponderhit"){
         workers.update_limit(SearchLimit(LimitType::Time, cached_think_time));
 
     } else if (first == "stop"){
-        workers.interrupt_and_join_threads();
+        workers.interrupt_and_wait();
 
     } else if (first == "quit"){
-        workers.interrupt_and_join_threads();
+        workers.interrupt_and_wait();
         tb_free();
         return 0;
     } else {
@@ -150,25 +305,79 @@ void UCIAgent::process_setoption(std::vector<std::string> command){
     } else if (option_name == "Hash"){
         int size = std::stoi(option_value);
         if ((size & (size - 1)) == 0){
+            // the table is freed and remapped, so no worker may probe it meanwhile
+            workers.interrupt_and_wait();
             tt.allocateMB(size);
-            std::cout << "info string hash size set to " << size << std::endl;
+            std::cout << "info string hash size set to " << size
+                      << " using " << Memory::page_type_name(tt.get_page_type()) << std::endl;
         } else {
             std::cout << "info string hash size must be a power of 2" << std::endl;
         }
     } else if (option_name == "Threads"){
-        workers.interrupt_and_join_threads();
+        workers.interrupt_and_wait();
         workers = WorkerPool(std::stoi(option_value), tt, nodes);
+        workers.main().engine.multi_pv = multi_pv;
+        workers.set_eval_cache(eval_cache);
+        tt.num_threads = workers.size();
         std::cout << "info string number of threads set to " << workers.size() << std::endl;
+    } else if (option_name == "MultiPV"){
+        workers.interrupt_and_wait();
+        // only the main thread reports lines, the helpers keep searching for the best move
+        multi_pv = std::clamp(std::stoi(option_value), 1, 256);
+        workers.main().engine.multi_pv = multi_pv;
+        std::cout << "info string multipv set to " << multi_pv << std::endl;
     } else if (option_name == "Nonsense"){
         workers.set_is_nonsense(option_value == "true");
         std::cout << "info string nonsense " << (option_value == "true" ? "activated" : "deactivated") << std::endl;
+    } else if (option_name == "EvalCache"){
+        workers.interrupt_and_wait();
+        eval_cache = (option_value == "true");
+        workers.set_eval_cache(eval_cache);
+        std::cout << "info string eval cache " << (eval_cache ? "activated" : "deactivated") << std::endl;
+    } else if (option_name == "LazyClear"){
+        tt.lazy_clear = (option_value == "true");
+        std::cout << "info string lazy hash clear " << (tt.lazy_clear ? "activated" : "deactivated") << std::endl;
+    } else if (option_name == "EvalFile"){
+        std::string path = option_value;
+        // handle path containing spaces
+        for (int i = 5; i < command.size(); i++)
+            path += " " + command[i];
+
+        workers.interrupt_and_wait();
+        std::string error;
+        if (path == "<embedded>" || path == "<empty>"){
+            NNUE::load_model();
+            std::cout << "info string using the embedded network" << std::endl;
+        } else if (NNUE::load_network_file(path, error)){
+            std::cout << "info string network loaded from " << path << std::endl;
+        } else {
+            std::cout << "info string failed to load network from " << path << ": " << error << std::endl;
+            return;
+        }
+        // accumulators were computed with the previous network
+        pos.reset_finny_table();
+        pos.synchronize();
+        workers.reset_finny_tables();
+    } else if (option_name == "LargePages"){
+        workers.interrupt_and_wait();
+        tt.set_huge_pages(option_value == "true");
+        std::cout << "info string hash uses " << Memory::page_type_name(tt.get_page_type()) << std::endl;
     } else if (is_number_string(option_value) && SPSA::is_registered(option_name)){
         SPSA::set_value(option_name, std::stoi(option_value));
     }
 }
 
+void UCIAgent::clear_hash(){
+    auto start = std::chrono::high_resolution_clock::now();
+    tt.clear();
+    int clear_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start
+    ).count();
+    std::cout << "info string hash cleared in " << clear_time << " ms" << std::endl;
+}
+
 void UCIAgent::process_position(std::vector<std::string> command){
-    workers.interrupt_and_join_threads();
+    workers.interrupt_and_wait();
 
     std::string fen = "";
     if (command[1] == "startpos"){
@@ -234,6 +443,7 @@ void UCIAgent::process_go(std::vector<std::string> command){
         limit = SearchLimit(LimitType::Time, get_think_time_from_go_command(command));
     }
 
+    tt.new_search();
     workers.start_searching(limit);
 }
 
@@ -265,4 +475,81 @@ int UCIAgent::get_think_time_from_go_command(std::vector<std::string> command){
                           num_moves_out_of_book,
                           movestogo,
                           engine_white ? winc: binc);
+}
+
+// prints the static evaluation of each position of an epd or fen file, from white's point of view,
+// one per line and in file order. only the first four fields of each line are read, and
+// lines that are not a valid position are skipped.
+void UCIAgent::process_evalbatch(std::vector<std::string> command){
+    if (command.size() < 2){
+        std::cout << "info string usage: evalbatch <file>" << std::endl;
+        return;
+    }
+
+    std::ifstream file(command[1]);
+    if (!file){
+        std::cout << "info string could not open " << command[1] << std::endl;
+        return;
+    }
+
+    constexpr int BATCH_SIZE = 1024;
+    std::vector<Accumulators> accumulators(BATCH_SIZE);
+    std::vector<Color> stm(BATCH_SIZE);
+    std::vector<int> piece_counts(BATCH_SIZE);
+    std::vector<int> material_scales(BATCH_SIZE);
+    std::vector<int> outputs(BATCH_SIZE);
+
+    NnueBoard board;
+    int64_t evaluated = 0;
+    int64_t skipped = 0;
+    int size = 0;
+
+    auto flush = [&](){
+        NNUE::run_batch(accumulators.data(), stm.data(), piece_counts.data(), outputs.data(), size);
+        for (int i = 0; i < size; i++){
+            int score = NnueBoard::scale_evaluation(outputs[i], material_scales[i]);
+            std::cout << (stm[i] == Color::BLACK ? -score : score) << "\n";
+        }
+        evaluated += size;
+        size = 0;
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::string line;
+    while (std::getline(file, line)){
+        std::vector<std::string> fields = split_string(line);
+        if (fields.size() < 4){
+            skipped += !fields.empty();
+            continue;
+        }
+
+        std::string fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+        if (!board.setFen(fen)
+         || board.pieces(PieceType::KING, Color::WHITE).count() != 1
+         || board.pieces(PieceType::KING, Color::BLACK).count() != 1
+         || board.occ().count() > 32){ // the output buckets cover at most 32 pieces
+            skipped++;
+            continue;
+        }
+
+        auto [white_features, black_features] = board.get_features();
+        NNUE::compute_accumulator(accumulators[size][(int)Color::WHITE], white_features);
+        NNUE::compute_accumulator(accumulators[size][(int)Color::BLACK], black_features);
+        stm[size] = board.sideToMove();
+        piece_counts[size] = board.occ().count();
+        material_scales[size] = board.material_scale();
+
+        if (++size == BATCH_SIZE)
+            flush();
+    }
+    flush();
+
+    int time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+
+    std::cout << "info string evaluated " << evaluated << " positions in " << time << " ms";
+    if (skipped > 0)
+        std::cout << ", skipped " << skipped << " invalid lines";
+    std::cout << std::endl;
 }
\ No newline at end of file
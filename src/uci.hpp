@@ -5,36 +5,86 @@
 #include <deque>
 #include <iostream>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
 #include "tune.hpp"
 #include "core.hpp"
 #include "benchmark.hpp"
 
+// a worker owns a thread that lives as long as the worker, and sleeps
+// on a condition variable between searches.
 struct Worker {
     public:
-    Worker(bool is_main_thread, TranspositionTable& tt, std::atomic<int64_t>& nodes);
-    std::thread thread;
+    Worker(bool is_main_thread, TranspositionTable& tt, NodeCounters& nodes);
+    ~Worker();
+
     Engine engine;
+
+    void start_searching(SearchLimit limit);
+    void wait_for_search_finished();
+
+    private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    SearchLimit limit;
+    bool searching = false;
+    bool exit = false;
+
+    std::thread thread; // started last, once every other member is initialized
+
+    void idle_loop();
+};
+
+// interrupts the search threads once the time limit of a search is reached,
+// so that searching threads never have to read the clock.
+class SearchTimer {
+    public:
+    SearchTimer();
+    ~SearchTimer();
+
+    void start(std::vector<Engine*> engines, SearchLimit limit);
+    void set_time_limit(int time_limit); // counted from the start of the search
+    void stop();
+
+    private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::chrono::time_point<std::chrono::steady_clock> start_time;
+    std::vector<Engine*> engines;
+    int time_limit = 0;
+    bool armed = false;
+    bool exit = false;
+
+    std::thread thread; // started last, once every other member is initialized
+
+    void run();
 };
 
 class WorkerPool {
     public:
-    WorkerPool(int size, TranspositionTable& tt, std::atomic<int64_t>& nodes);
+    WorkerPool(int size, TranspositionTable& tt, NodeCounters& nodes);
 
     int size();
-    void clear_state();
+    void clear_histories();
     void synchronize();
+    void reset_finny_tables();
     void set_tablebase_loaded(bool tablebase_loaded);
     void set_is_nonsense(bool is_nonsense);
+    void set_eval_cache(bool enabled);
     void set_position(NnueBoard& pos);
     void update_limit(SearchLimit limit);
 
     void start_searching(SearchLimit limit);
-    void interrupt_and_join_threads();
+    void interrupt_and_wait();
 
     Worker& main();
 
     private:
     std::deque<Worker> workers;
+    // behind a pointer so that the pool stays movable. declared after the workers,
+    // so that it is destroyed before them.
+    std::unique_ptr<SearchTimer> timer = std::make_unique<SearchTimer>();
 };
 
 class UCIAgent {
@@ -43,7 +93,7 @@ class UCIAgent {
 
     NnueBoard pos;
     TranspositionTable tt;
-    std::atomic<int64_t> nodes;
+    NodeCounters nodes;
     WorkerPool workers;
 
     bool process_uci_command(std::string command);
@@ -52,7 +102,13 @@ class UCIAgent {
     int num_moves_out_of_book = 0;
 
     int cached_think_time;
+
+    // kept here so that they survive the worker pool being rebuilt
+    int multi_pv = 1;
+    bool eval_cache = false;
     
+    void clear_hash();
+
     void process_setoption(std::vector<std::string> command);
     
     void process_position(std::vector<std::string> command);
@@ -63,5 +119,7 @@ class UCIAgent {
 
     void process_eval(std::vector<std::string> command);
 
+    void process_evalbatch(std::vector<std::string> command);
+
     int get_think_time_from_go_command(std::vector<std::string> command);
 };
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "constants.hpp"
+#include "network_file.hpp"
+
+// converts the network exported by the trainer to the layout used by the engine:
+// the feature transformer outputs are permuted with FT_PERMUTATION, and the layer 1
+// weights are permuted the same way, then stored in blocks for the sparse matrix
+// multiplication. this runs at build time, so the engine uses the embedded network in place.
+// the network is also written as a single network.bin file, which can be loaded with EvalFile.
+
+// usage: prepare_network <input folder> <output folder>
+
+template<typename T>
+std::vector<T> read_blob(std::filesystem::path path, size_t size){
+    std::vector<T> data(size);
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.read(reinterpret_cast<char*>(data.data()), size * sizeof(T))){
+        std::cerr << "could not read " << size * sizeof(T) << " bytes from " << path << std::endl;
+        std::exit(1);
+    }
+    return data;
+}
+
+template<typename T>
+void copy_to_payload(std::vector<uint8_t>& payload, size_t offset, const std::vector<T>& data){
+    std::memcpy(payload.data() + offset, data.data(), data.size() * sizeof(T));
+}
+
+template<typename T>
+void write_blob(std::filesystem::path path, const std::vector<T>& data){
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T))){
+        std::cerr << "could not write " << path << std::endl;
+        std::exit(1);
+    }
+}
+
+int main(int argc, char* argv[]){
+    if (argc != 3){
+        std::cerr << "usage: prepare_network <input folder> <output folder>" << std::endl;
+        return 1;
+    }
+    std::filesystem::path input = argv[1];
+    std::filesystem::path output = argv[2];
+
+    // feature transformer
+    auto ft_weights_in = read_blob<int16_t>(input / "feature_transformer/weights.bin", L0_WEIGHTS_SIZE);
+    auto ft_bias_in = read_blob<int16_t>(input / "feature_transformer/bias.bin", L0_BIAS_SIZE);
+
+    std::vector<int16_t> ft_weights(L0_WEIGHTS_SIZE);
+    std::vector<int16_t> ft_bias(L0_BIAS_SIZE);
+
+    for (int a = 0; a < INPUT_SIZE; a++){
+        for (int j = 0; j < ACC_SIZE / 2; j++){
+            ft_weights[a * ACC_SIZE + j] = ft_weights_in[a * ACC_SIZE + FT_PERMUTATION[j]];
+            ft_weights[a * ACC_SIZE + ACC_SIZE / 2 + j] = ft_weights_in[a * ACC_SIZE + ACC_SIZE / 2 + FT_PERMUTATION[j]];
+        }
+    }
+
+    for (int j = 0; j < ACC_SIZE / 2; j++){
+        ft_bias[j] = ft_bias_in[FT_PERMUTATION[j]];
+        ft_bias[ACC_SIZE / 2 + j] = ft_bias_in[ACC_SIZE / 2 + FT_PERMUTATION[j]];
+    }
+
+    // layer 1
+    auto l1_weights_in = read_blob<int8_t>(input / "layer_1/weights.bin", BUCKETED_L1_WEIGHTS_SIZE);
+    auto l1_bias_in = read_blob<int32_t>(input / "layer_1/bias.bin", BUCKETED_L1_BIAS_SIZE);
+
+    std::vector<int8_t> permuted_l1(BUCKETED_L1_WEIGHTS_SIZE);
+
+    for (int bucket = 0; bucket < NUM_OUTPUT_BUCKETS; bucket++){
+        for (int row = 0; row < L1_OUTPUT_SIZE; row++){
+            for (int col = 0; col < ACC_SIZE / 2; col++){
+                permuted_l1[bucket * L1_WEIGHTS_SIZE + row * L1_INPUT_SIZE + col] =
+                    l1_weights_in[bucket * L1_WEIGHTS_SIZE + row * L1_INPUT_SIZE + FT_PERMUTATION[col]];
+
+                permuted_l1[bucket * L1_WEIGHTS_SIZE + row * L1_INPUT_SIZE + ACC_SIZE / 2 + col] =
+                    l1_weights_in[bucket * L1_WEIGHTS_SIZE + row * L1_INPUT_SIZE + ACC_SIZE / 2 + FT_PERMUTATION[col]];
+            }
+        }
+    }
+
+    // blocks of 4 columns span all the rows, so any register width reads consecutive rows.
+    std::vector<int8_t> l1_weights(BUCKETED_L1_WEIGHTS_SIZE);
+    int idx = 0;
+    for (int bucket = 0; bucket < NUM_OUTPUT_BUCKETS; bucket++)
+        for (int col_block = 0; col_block < L1_INPUT_SIZE; col_block += 4)
+            for (int row = 0; row < L1_OUTPUT_SIZE; row++)
+                for (int n = 0; n < 4; n++)                             // col within block
+                    l1_weights[idx++] = permuted_l1[
+                        bucket * L1_WEIGHTS_SIZE
+                        + row * L1_INPUT_SIZE
+                        + (col_block + n)
+                    ];
+
+    std::vector<int32_t> l1_bias(BUCKETED_L1_BIAS_SIZE);
+    for (int i = 0; i < BUCKETED_L1_BIAS_SIZE; i++)
+        l1_bias[i] = l1_bias_in[i] >> 1;
+
+    // layer 2 is used as is
+    auto l2_weights = read_blob<int16_t>(input / "layer_2/weights.bin", BUCKETED_L2_WEIGHTS_SIZE);
+    auto l2_bias = read_blob<int32_t>(input / "layer_2/bias.bin", BUCKETED_L2_BIAS_SIZE);
+
+    write_blob(output / "feature_transformer/weights.bin", ft_weights);
+    write_blob(output / "feature_transformer/bias.bin", ft_bias);
+    write_blob(output / "layer_1/weights.bin", l1_weights);
+    write_blob(output / "layer_1/bias.bin", l1_bias);
+    write_blob(output / "layer_2/weights.bin", l2_weights);
+    write_blob(output / "layer_2/bias.bin", l2_bias);
+
+    std::vector<uint8_t> payload(NetworkFile::PAYLOAD_SIZE, 0);
+    copy_to_payload(payload, NetworkFile::FT_WEIGHTS_OFFSET, ft_weights);
+    copy_to_payload(payload, NetworkFile::FT_BIAS_OFFSET, ft_bias);
+    copy_to_payload(payload, NetworkFile::L1_WEIGHTS_OFFSET, l1_weights);
+    copy_to_payload(payload, NetworkFile::L1_BIAS_OFFSET, l1_bias);
+    copy_to_payload(payload, NetworkFile::L2_WEIGHTS_OFFSET, l2_weights);
+    copy_to_payload(payload, NetworkFile::L2_BIAS_OFFSET, l2_bias);
+
+    NetworkFile::Header header = {};
+    std::memcpy(header.magic, NetworkFile::MAGIC, sizeof(header.magic));
+    header.version = NetworkFile::VERSION;
+    header.l1_block_size = L1_OUTPUT_SIZE;
+    header.payload_size = NetworkFile::PAYLOAD_SIZE;
+    header.checksum = NetworkFile::checksum(payload.data(), payload.size());
+
+    std::vector<uint8_t> network_file(sizeof(header));
+    std::memcpy(network_file.data(), &header, sizeof(header));
+    network_file.insert(network_file.end(), payload.begin(), payload.end());
+    write_blob(output / "network.bin", network_file);
+
+    return 0;
+}
@@ -3,8 +3,11 @@
 #include <iostream>
 
 int main(){
+    NNUE::init();
+    Cuckoo::init();
+
     TranspositionTable tt;
-    std::atomic<int64_t> nodes = 0;
+    NodeCounters nodes;
     Engine engine = Engine(true, tt, nodes);
 
     std::vector<std::string> fens = {
@@ -4,6 +4,9 @@
 #include <fstream>
 
 int main(){
+    NNUE::init();
+    Cuckoo::init();
+
     UCIAgent uci_engine;
     std::ifstream file(bread_DEBUG_UCI_COMMANDS_PATH);
     std::string input;
@@ -23,16 +26,12 @@ int main(){
 
         auto tokens = split_string(input);
         if (!tokens.empty() && tokens[0] == "go") {
-            if (uci_engine.workers.main().thread.joinable()) {
-                uci_engine.workers.main().thread.join();
-            }
-            correct_nodes.push_back(std::stoi(tokens[2]) == uci_engine.nodes);
+            uci_engine.workers.main().wait_for_search_finished();
+            correct_nodes.push_back(std::stoi(tokens[2]) == uci_engine.nodes.total());
         }
     }
 
-    if (uci_engine.workers.main().thread.joinable()) {
-        uci_engine.workers.main().thread.join();
-    }
+    uci_engine.workers.main().wait_for_search_finished();
 
     std::cout << "ok\n";
     for (int i = 0; i < correct_nodes.size(); i++){